@@ -29,6 +29,10 @@
 #cmakedefine HAVE_GETOPT_H
 #cmakedefine HAVE_STDINT_H
 #cmakedefine HAVE_GRP_H
+#cmakedefine HAVE_POLL_H
+#cmakedefine HAVE_SYS_EPOLL_H
+#cmakedefine HAVE_SYS_SENDFILE_H
+#cmakedefine HAVE_SYS_MMAN_H
 
 
 /* functions */
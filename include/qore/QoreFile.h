@@ -559,6 +559,40 @@ public:
    //! returns true if the file is a tty
    DLLEXPORT bool isTty() const;
 
+   //! maps the open file into memory so that reads are served from the mapping without read() system calls
+   /** the file must be a regular file opened read-only; the mapping covers the size of the file at the time of the call and is released when the file is closed
+       @param xsink if an error occurs, the Qore-language exception info will be added here
+       @return 0 for success, -1 for error (meaning that an exception has been raised)
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT int map(ExceptionSink *xsink);
+
+   //! returns true if the file is mapped into memory
+   /** @since %Qore 0.8.12
+   */
+   DLLEXPORT bool isMapped() const;
+
+   //! writes any data in the write buffer to the file
+   /** @param xsink if an error occurs, the Qore-language exception info will be added here
+       @return 0 for success, -1 for error (meaning that an exception has been raised)
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT int flush(ExceptionSink *xsink);
+
+   //! sets the size of the write buffer; 0 (the default) means that writes are not buffered
+   /** buffered data is written when the buffer is full and before the file is read, positioned, synced, or closed
+       @param size the new buffer size in bytes
+       @param xsink if an error occurs, the Qore-language exception info will be added here
+       @return 0 for success, -1 for error (meaning that an exception has been raised)
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT int setWriteBufferSize(int64 size, ExceptionSink *xsink);
+
+   //! returns the size of the write buffer; 0 means that writes are not buffered
+   /** @since %Qore 0.8.12
+   */
+   DLLEXPORT int64 getWriteBufferSize() const;
+
    //! sets terminal attributes
    DLLLOCAL int setTerminalAttributes(int action, QoreTermIOS *ios, ExceptionSink *xsink) const;
 
@@ -596,8 +596,27 @@ public:
    */
    DLLEXPORT void parseDefine(const char* str, const char* val);
 
+   //! returns a new Program object that shares the parsed code of this Program but has its own global variables
+   /** functions, classes, constants and top-level code are shared with this object without being parsed again;
+       global variables are copied with their current values, where container values are only copied when they are
+       modified in either Program (copy on write)
+
+       @param xsink if an error occurs, the Qore-language exception information will be added here
+
+       @return the new Program object, or 0 if an exception was raised; the caller owns the reference returned
+
+       @note class static variables and objects created before the clone are shared with the source Program
+       @note top-level statements cannot be parsed into a clone (%PO_NO_TOP_LEVEL_STATEMENTS is set automatically)
+
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT QoreProgram* clone(ExceptionSink* xsink);
+
    DLLLOCAL QoreProgram(QoreProgram* pgm, int64 po, bool ec = false, const char* ecn = 0);
 
+   // creates a clone of the given program; see clone()
+   DLLLOCAL QoreProgram(const QoreProgram& src, bool);
+
    DLLLOCAL LocalVar *createLocalVar(const char* name, const QoreTypeInfo *typeInfo);
 
    // returns 0 if a "requires" exception has already occurred
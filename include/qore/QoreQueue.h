@@ -70,6 +70,21 @@ public:
    //! remove a node from the beginning of the queue
    DLLEXPORT AbstractQoreNode* shift(ExceptionSink* xsink, int timeout_ms = 0, bool* to = 0);
 
+   //! push all elements of the list at the end of the queue
+   /** elements are added under a single lock acquisition as long as there is room in the queue; if the queue has a maximum
+       size, the call blocks while the queue is full; if a timeout occurs, the remaining elements are not added to the queue
+
+       @since %Qore 0.8.12
+    */
+   DLLEXPORT void pushList(ExceptionSink* xsink, const QoreListNode* l, int timeout_ms = 0, bool* to = 0);
+
+   //! remove up to \a max nodes from the beginning of the queue (all available nodes if \a max <= 0); blocks until at least one node is available
+   /** @return the list of nodes removed or 0 if an error or timeout occurred
+
+       @since %Qore 0.8.12
+    */
+   DLLEXPORT QoreListNode* shiftList(ExceptionSink* xsink, int max, int timeout_ms = 0, bool* to = 0);
+
    //! remove a node from the end of the queue
    DLLEXPORT AbstractQoreNode* pop(ExceptionSink* xsink, int timeout_ms = 0, bool* to = 0);
 
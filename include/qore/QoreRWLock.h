@@ -373,6 +373,12 @@ public:
 
    //! tries to grab the read lock; does not block if unsuccessful; returns 0 if successful
    DLLLOCAL int tryrdlock();
+
+   //! returns the write sequence count for an optimistic read without the lock; an odd value means that a write is in progress
+   DLLLOCAL unsigned readSeqBegin() const;
+
+   //! returns true if a write was started since readSeqBegin() returned the given value, meaning that the data must be read again with the lock held
+   DLLLOCAL bool readSeqRetry(unsigned s) const;
 };
 
 #endif
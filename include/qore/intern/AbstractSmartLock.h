@@ -38,10 +38,47 @@
 #include <qore/QoreCondition.h>
 #include <qore/AbstractThreadResource.h>
 
+#include <string>
+
 class VLock;
 
 class QoreCondition;
 
+// lock contention statistics are only collected while this flag is set
+DLLLOCAL extern volatile bool qore_lock_profiling;
+
+// sets the lock contention profiling flag and returns the old value
+DLLLOCAL bool set_lock_contention_profiling(bool enable);
+// returns a list of statistics hashes for all locks with statistics sorted by total wait time
+DLLLOCAL QoreListNode* get_lock_contention_report();
+
+// contention statistics for a lock; only allocated for locks acquired while lock contention profiling is enabled
+class QoreLockStats {
+public:
+   // protects the statistics below so they can be read by other threads
+   mutable QoreThreadLock m;
+   // the name of the lock class
+   const char* name;
+   // the location where the lock was first acquired while lock profiling was enabled
+   std::string loc;
+   int64 acquisitions,  // number of times the lock was acquired
+      contended,        // number of acquisitions that had to wait for the lock
+      total_wait_us,    // total time waited for the lock in microseconds
+      max_wait_us;      // longest wait for the lock in microseconds
+   // the locations of the last acquisition before the longest wait and of the waiting thread
+   std::string max_wait_holder, max_wait_waiter;
+
+   // location of the last acquisition; protected by the lock's asl_lock; stored as a string because the
+   // location's file name belongs to the Program that acquired the lock, which can be deleted before the lock
+   std::string holder_loc;
+
+   DLLLOCAL QoreLockStats(const char* n, const QoreProgramLocation& l);
+
+   DLLLOCAL void add(bool n_contended, int64 wait_us, const std::string& holder, const QoreProgramLocation& waiter);
+
+   DLLLOCAL QoreHashNode* getHash() const;
+};
+
 class AbstractSmartLock : public AbstractThreadResource {
 protected:
    enum lock_status_e { Lock_Deleted = -2, Lock_Unlocked = -1 };
@@ -49,6 +86,8 @@ protected:
    VLock *vl;
    int tid, waiting;
    cond_map_t cmap;       // map of condition variables to wait counts
+   // lock contention statistics; 0 if the lock has never been acquired while lock profiling was enabled
+   QoreLockStats* stats;
 
    virtual int releaseImpl() = 0;
    virtual int releaseImpl(ExceptionSink *xsink) = 0;
@@ -71,8 +110,8 @@ public:
    mutable QoreThreadLock asl_lock;
    QoreCondition asl_cond;
 
-   DLLLOCAL AbstractSmartLock() : vl(NULL), tid(-1), waiting(0)  {}
-   DLLLOCAL virtual ~AbstractSmartLock() {}
+   DLLLOCAL AbstractSmartLock() : vl(NULL), tid(-1), waiting(0), stats(0) {}
+   DLLLOCAL virtual ~AbstractSmartLock();
    DLLLOCAL void destructor(ExceptionSink *xsink);
    DLLLOCAL virtual void cleanup(ExceptionSink *xsink);
 
@@ -99,6 +138,30 @@ public:
       cond_map_t::const_iterator i = cmap.find(cond);
       return i != cmap.end() ? i->second : 0;
    }
+
+   // returns the lock contention statistics for the lock
+   DLLLOCAL QoreHashNode* getStats() const;
+
+   friend class QoreLockProfileHelper;
+};
+
+// records lock contention statistics for a single lock acquisition if lock profiling is enabled;
+// must be created and used with the lock's asl_lock held
+class QoreLockProfileHelper {
+protected:
+   AbstractSmartLock* asl;
+   VLock* nvl;
+   // the thread's wait count when the acquisition started
+   unsigned waits;
+   int64 start;
+   // the location of the last acquisition when this acquisition started
+   std::string holder;
+
+public:
+   DLLLOCAL QoreLockProfileHelper(AbstractSmartLock* a, VLock* n_nvl);
+
+   // must be called when the lock has been acquired
+   DLLLOCAL void acquired();
 };
 
 #endif
@@ -690,7 +690,7 @@ public:
         nn_unique_flags(old.nn_unique_flags),
         nn_count(old.nn_count),
         parse_rt_done(true), parse_init_done(true),
-        has_user(old.has_user), has_builtin(old.has_builtin), has_mod_pub(false), inject(n_inject),
+        has_user(old.has_user), has_builtin(old.has_builtin), has_mod_pub((po & PO_INTERN_CLONE) ? old.has_mod_pub : false), inject(n_inject),
         nn_uniqueReturnType(old.nn_uniqueReturnType) {
       bool no_user = po & PO_NO_INHERIT_USER_FUNC_VARIANTS;
       bool no_builtin = po & PO_NO_SYSTEM_FUNC_VARIANTS;
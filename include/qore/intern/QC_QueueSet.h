@@ -0,0 +1,112 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/* 
+  QC_QueueSet.h
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_CLASS_QUEUESET_H
+
+#define _QORE_CLASS_QUEUESET_H
+
+#include <qore/QoreQueue.h>
+#include <qore/QoreRWLock.h>
+#include <qore/intern/QoreQueueIntern.h>
+
+#include <vector>
+
+DLLLOCAL extern qore_classid_t CID_QUEUESET;
+DLLLOCAL extern QoreClass* QC_QUEUESET;
+
+DLLLOCAL QoreClass* initQueueSetClass(QoreNamespace& ns);
+
+// a set of queues that can be waited on for data as a unit
+class QueueSet : public AbstractPrivateData {
+protected:
+   // a Queue object and its private data
+   typedef std::pair<QoreObject*, Queue*> qs_entry_t;
+   typedef std::vector<qs_entry_t> qsvec_t;
+
+   // protects the queue list; the read lock is only held while checking the queues for data
+   QoreRWLock rwl;
+
+   // the waiter registered with each queue in the set
+   QoreQueueWaiter w;
+
+   // the queues in the set
+   qsvec_t ql;
+
+   // the offset of the queue to check first in the next select() call, so that data on queues later in the set is
+   // not starved by queues earlier in the set that always have data
+   unsigned next;
+   QoreThreadLock next_lock;
+
+   // returns the offset of the queue to check first and advances the offset for the next call
+   DLLLOCAL unsigned getStart(unsigned size) {
+      AutoLocker al(next_lock);
+      unsigned start = next % size;
+      next = start + 1;
+      return start;
+   }
+
+   DLLLOCAL virtual ~QueueSet() {
+      assert(ql.empty());
+   }
+
+public:
+   DLLLOCAL QueueSet() : next(0) {
+   }
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+      if (ROdereference()) {
+         clear(xsink);
+         delete this;
+      }
+   }
+
+   // adds a Queue object to the set
+   DLLLOCAL int add(QoreObject* o, ExceptionSink* xsink);
+
+   // adds all Queue objects in the list to the set
+   DLLLOCAL int addList(const QoreListNode* l, ExceptionSink* xsink);
+
+   // removes a Queue object from the set; returns true if the object was in the set
+   DLLLOCAL bool remove(const QoreObject* o, ExceptionSink* xsink);
+
+   // removes all queues from the set
+   DLLLOCAL void clear(ExceptionSink* xsink);
+
+   DLLLOCAL int size() {
+      QoreAutoRWReadLocker al(rwl);
+      return (int)ql.size();
+   }
+
+   // waits for data on any of the queues and returns a hash of the queue, its offset in the set, and the value removed
+   DLLLOCAL QoreHashNode* select(ExceptionSink* xsink, int timeout_ms = 0, bool* to = 0);
+};
+
+#endif // _QORE_CLASS_QUEUESET_H
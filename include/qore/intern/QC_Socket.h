@@ -76,6 +76,18 @@ public:
    DLLLOCAL static void setAccept(QoreSocketObject& sock, QoreObject* o) {
       sock.priv->setAccept(o);
    }
+
+   //! returns true if data has already been read into the socket's buffer or is pending in its SSL connection; returns false without blocking if the socket is in use in another thread
+   DLLLOCAL static bool tryIsDataBuffered(QoreSocketObject& sock);
+
+   //! sends len bytes of data from the file descriptor starting at offset without changing the file position; returns the number of bytes sent or -1 if an exception was raised
+   DLLLOCAL static int64 sendFile(QoreSocketObject& sock, int fd, int64 offset, int64 len, int timeout_ms, ExceptionSink* xsink);
+
+   //! sets the size of the socket's read buffer; 0 = adapt the size to the amount of data received
+   DLLLOCAL static void setReadBufferSize(QoreSocketObject& sock, qore_size_t size);
+
+   //! returns the size of the socket's read buffer for the next read
+   DLLLOCAL static qore_size_t getReadBufferSize(QoreSocketObject& sock);
 };
 
 #endif // _QORE_CLASS_QORESOCKET_H
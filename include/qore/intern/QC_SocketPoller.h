@@ -0,0 +1,130 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/* 
+  QC_SocketPoller.h
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_CLASS_SOCKETPOLLER_H
+
+#define _QORE_CLASS_SOCKETPOLLER_H
+
+#include <qore/intern/QC_Socket.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#include <map>
+#include <vector>
+
+DLLLOCAL extern qore_classid_t CID_SOCKETPOLLER;
+DLLLOCAL extern QoreClass* QC_SOCKETPOLLER;
+
+DLLLOCAL QoreClass* initSocketPollerClass(QoreNamespace& ns);
+
+// SocketPoller event codes
+#define SOCK_POLLIN  (1 << 0)
+#define SOCK_POLLOUT (1 << 1)
+#define SOCK_POLLERR (1 << 2)
+
+// maximum number of events returned by a single call to epoll_wait()
+#ifndef QORE_SOCKETPOLLER_MAX_EVENTS
+#define QORE_SOCKETPOLLER_MAX_EVENTS 256
+#endif
+
+// a set of Socket objects that can be waited on for I/O readiness as a unit
+/* uses epoll where available, so waiting does not depend on the number of sockets in the set,
+   otherwise poll() is used
+*/
+class SocketPoller : public AbstractPrivateData {
+protected:
+   // a Socket object in the set
+   struct sp_entry {
+      QoreObject* obj;
+      QoreSocketObject* sock;
+      int events;
+      AbstractQoreNode* arg;
+   };
+
+   // map of descriptors to entries
+   typedef std::map<int, sp_entry> sp_fd_map_t;
+   // map of Socket objects to descriptors
+   typedef std::map<const QoreObject*, int> sp_obj_map_t;
+
+   // protects the maps; not held while waiting
+   QoreThreadLock m;
+
+   sp_fd_map_t fmap;
+   sp_obj_map_t omap;
+
+#ifdef HAVE_SYS_EPOLL_H
+   int epfd;
+#endif
+
+   DLLLOCAL virtual ~SocketPoller();
+
+   // removes the entry for the given descriptor from the set; must be called with the lock held
+   DLLLOCAL void removeIntern(sp_fd_map_t::iterator i);
+
+   DLLLOCAL static void derefEntry(sp_entry& e, ExceptionSink* xsink);
+
+   // adds a hash for the entry and events to the list
+   DLLLOCAL static void addResult(QoreListNode& l, const sp_entry& e, int events);
+
+public:
+   DLLLOCAL SocketPoller(ExceptionSink* xsink);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+      if (ROdereference()) {
+         clear(xsink);
+         delete this;
+      }
+   }
+
+   // adds a Socket object to the set; takes ownership of the reference for arg
+   DLLLOCAL int add(QoreObject* o, QoreSocketObject* s, int events, AbstractQoreNode* arg, ExceptionSink* xsink);
+
+   // changes the events waited for on a Socket object in the set
+   DLLLOCAL int modify(const QoreObject* o, int events, ExceptionSink* xsink);
+
+   // removes a Socket object from the set; returns true if the object was in the set
+   DLLLOCAL bool remove(const QoreObject* o, ExceptionSink* xsink);
+
+   // removes all sockets from the set
+   DLLLOCAL void clear(ExceptionSink* xsink);
+
+   DLLLOCAL int size() {
+      AutoLocker al(m);
+      return (int)fmap.size();
+   }
+
+   // waits for any of the sockets to become ready and returns a list of hashes for the ready sockets
+   DLLLOCAL QoreListNode* wait(int timeout_ms, ExceptionSink* xsink);
+};
+
+#endif // _QORE_CLASS_SOCKETPOLLER_H
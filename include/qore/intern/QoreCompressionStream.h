@@ -0,0 +1,314 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreCompressionStream.h
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORECOMPRESSIONSTREAM_H
+
+#define _QORE_QORECOMPRESSIONSTREAM_H
+
+#include <zlib.h>
+#include <bzlib.h>
+
+#include <qore/intern/ql_compression.h>
+
+#include <string.h>
+#include <limits.h>
+
+// compression algorithms supported by the stream classes
+#define QORE_COMP_DEFLATE 0
+#define QORE_COMP_GZIP    1
+#define QORE_COMP_BZIP2   2
+
+// the initial amount of output space added to the result when the output buffer is full
+#ifndef QORE_COMPRESSION_BUFSIZE
+#define QORE_COMPRESSION_BUFSIZE 16384
+#endif
+
+// the maximum amount of output space added to the result at once
+#define QORE_COMPRESSION_MAXSTEP (16 * 1024 * 1024)
+
+// incremental compression or decompression state for the CompressionEncoder and CompressionDecoder classes
+/* data is processed as it is passed to update(); only the output produced so far is returned, so memory usage
+   does not depend on the total size of the data
+*/
+class QoreCompressionStream : public AbstractPrivateData {
+protected:
+   z_stream zs;
+   bz_stream bs;
+   // the algorithm; one of the QORE_COMP_* values
+   int alg;
+   // true for compression, false for decompression
+   bool encode;
+   // true if the library stream has been initialized
+   bool init;
+   // true when the end of the compressed stream has been reached
+   bool done;
+   // serializes access from multiple threads
+   QoreThreadLock m;
+
+   DLLLOCAL virtual ~QoreCompressionStream() {
+      if (!init)
+         return;
+      if (alg == QORE_COMP_BZIP2) {
+         if (encode)
+            BZ2_bzCompressEnd(&bs);
+         else
+            BZ2_bzDecompressEnd(&bs);
+      }
+      else if (encode)
+         deflateEnd(&zs);
+      else
+         inflateEnd(&zs);
+   }
+
+   DLLLOCAL const char* getName() const {
+      return encode ? "CompressionEncoder" : "CompressionDecoder";
+   }
+
+   DLLLOCAL const char* getErr() const {
+      return encode ? "COMPRESSION-ERROR" : "DECOMPRESSION-ERROR";
+   }
+
+   // makes room for step more bytes after the used bytes in the output buffer; returns -1 for error
+   DLLLOCAL int reserve(BinaryNode& out, qore_size_t used, qore_size_t step, ExceptionSink* xsink) {
+      if (out.preallocate(used + step)) {
+         xsink->outOfMemory();
+         return -1;
+      }
+      return 0;
+   }
+
+   // returns the output space to use for the first call to the compression library; small inputs get small buffers
+   DLLLOCAL static qore_size_t getInitialStep(qore_size_t len) {
+      return len < QORE_COMPRESSION_BUFSIZE / 4 ? len * 4 + 64 : QORE_COMPRESSION_BUFSIZE;
+   }
+
+   // returns the output space to add when the buffer is full; the buffer grows geometrically to avoid repeated copying
+   DLLLOCAL static qore_size_t getNextStep(qore_size_t used) {
+      if (used < QORE_COMPRESSION_BUFSIZE)
+         return QORE_COMPRESSION_BUFSIZE;
+      return used > QORE_COMPRESSION_MAXSTEP ? QORE_COMPRESSION_MAXSTEP : used;
+   }
+
+   DLLLOCAL int processZlib(const void* ptr, qore_size_t len, bool finish, bool flush, BinaryNode& out, ExceptionSink* xsink) {
+      zs.next_in = (Bytef*)ptr;
+      zs.avail_in = len;
+
+      qore_size_t used = 0, step = getInitialStep(len);
+      while (true) {
+         if (reserve(out, used, step, xsink))
+            return -1;
+         zs.next_out = (Bytef*)out.getPtr() + used;
+         zs.avail_out = step;
+
+         int rc;
+         if (encode)
+            rc = deflate(&zs, finish ? Z_FINISH : (flush ? Z_SYNC_FLUSH : Z_NO_FLUSH));
+         else
+            rc = inflate(&zs, Z_NO_FLUSH);
+
+         used += step - zs.avail_out;
+         step = getNextStep(used);
+
+         if (rc == Z_STREAM_END) {
+            done = true;
+            break;
+         }
+         // Z_BUF_ERROR means that no progress was possible; more input is needed
+         if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            do_zlib_exception(rc, encode ? "deflate" : "inflate", xsink);
+            return -1;
+         }
+         // the output buffer was filled; there may be more output
+         if (!zs.avail_out)
+            continue;
+         // otherwise all input has been processed
+         break;
+      }
+
+      out.setSize(used);
+      return checkTrailingData(zs.avail_in, xsink);
+   }
+
+   DLLLOCAL int processBzip2(const void* ptr, qore_size_t len, bool finish, bool flush, BinaryNode& out, ExceptionSink* xsink) {
+      bs.next_in = (char*)ptr;
+      bs.avail_in = len;
+
+      qore_size_t used = 0, step = getInitialStep(len);
+      while (true) {
+         if (reserve(out, used, step, xsink))
+            return -1;
+         bs.next_out = (char*)out.getPtr() + used;
+         bs.avail_out = step;
+
+         int rc;
+         if (encode)
+            rc = BZ2_bzCompress(&bs, finish ? BZ_FINISH : (flush ? BZ_FLUSH : BZ_RUN));
+         else
+            rc = BZ2_bzDecompress(&bs);
+
+         used += step - bs.avail_out;
+         step = getNextStep(used);
+
+         if (rc == BZ_STREAM_END) {
+            done = true;
+            break;
+         }
+         // BZ_FLUSH_OK means that the flush is not complete yet; BZ_RUN_OK is returned when it is
+         if (flush && rc == BZ_FLUSH_OK)
+            continue;
+         if (rc != (encode ? (finish ? BZ_FINISH_OK : BZ_RUN_OK) : BZ_OK)) {
+            xsink->raiseException(encode ? "BZIP2-COMPRESS-ERROR" : "BZIP2-DECOMPRESS-ERROR", "error code %d returned from %s()", rc, encode ? "BZ2_bzCompress" : "BZ2_bzDecompress");
+            return -1;
+         }
+         if (!finish && !bs.avail_in && bs.avail_out)
+            break;
+      }
+
+      out.setSize(used);
+      return checkTrailingData(bs.avail_in, xsink);
+   }
+
+   // raises an exception if compressed data follows the end of the compressed stream
+   DLLLOCAL int checkTrailingData(unsigned avail, ExceptionSink* xsink) const {
+      if (done && avail) {
+         xsink->raiseException(getErr(), "%u byte%s of data found after the end of the compressed stream", avail, avail == 1 ? "" : "s");
+         return -1;
+      }
+      return 0;
+   }
+
+   // processes the given data and returns the output produced; if flush is true, all pending compressed output is returned
+   DLLLOCAL BinaryNode* process(const void* ptr, qore_size_t len, bool finish, ExceptionSink* xsink, bool flush = false) {
+      AutoLocker al(m);
+
+      // the decompressor produces all available output for each block of data, so there is nothing to do for finish()
+      // except to make sure that the compressed data was complete
+      if (!encode && !len) {
+         if (finish && !done) {
+            xsink->raiseException(getErr(), "%s::finish(): the compressed data is incomplete", getName());
+            return 0;
+         }
+         return new BinaryNode;
+      }
+
+      if (done) {
+         if (!len)
+            return new BinaryNode;
+         xsink->raiseException(getErr(), encode
+                               ? "%s::update() called after the compressed stream was finished"
+                               : "%s::update() called with data after the end of the compressed stream", getName());
+         return 0;
+      }
+
+      if (len > UINT_MAX) {
+         xsink->raiseException(getErr(), "cannot process "QLLD" bytes in one call; the maximum is %u", (int64)len, UINT_MAX);
+         return 0;
+      }
+
+      SimpleRefHolder<BinaryNode> out(new BinaryNode);
+      int rc = alg == QORE_COMP_BZIP2
+         ? processBzip2(ptr, len, finish, flush, **out, xsink)
+         : processZlib(ptr, len, finish, flush, **out, xsink);
+      if (rc)
+         return 0;
+
+      if (finish && !done) {
+         xsink->raiseException(getErr(), "%s::finish(): the compressed data is incomplete", getName());
+         return 0;
+      }
+
+      return out.release();
+   }
+
+public:
+   DLLLOCAL QoreCompressionStream(const char* name, bool n_encode, int level, ExceptionSink* xsink) : encode(n_encode), init(false), done(false) {
+      if (!strcasecmp(name, "deflate"))
+         alg = QORE_COMP_DEFLATE;
+      else if (!strcasecmp(name, "gzip"))
+         alg = QORE_COMP_GZIP;
+      else if (!strcasecmp(name, "bzip2"))
+         alg = QORE_COMP_BZIP2;
+      else {
+         xsink->raiseException(getErr(), "unknown compression algorithm '%s'; supported algorithms: 'deflate', 'gzip', 'bzip2'", name);
+         return;
+      }
+
+      if (alg == QORE_COMP_BZIP2) {
+         memset(&bs, 0, sizeof(bs));
+         int rc = encode
+            ? BZ2_bzCompressInit(&bs, level < 0 ? BZ2_DEFAULT_COMPRESSION : level, QORE_BZ2_VERBOSITY, QORE_BZ2_WORK_FACTOR)
+            : BZ2_bzDecompressInit(&bs, QORE_BZ2_VERBOSITY, 0);
+         if (rc != BZ_OK) {
+            xsink->raiseException(encode ? "BZIP2-COMPRESS-ERROR" : "BZIP2-DECOMPRESS-ERROR", "code %d returned from %s()", rc, encode ? "BZ2_bzCompressInit" : "BZ2_bzDecompressInit");
+            return;
+         }
+      }
+      else {
+         memset(&zs, 0, sizeof(zs));
+         int rc;
+         if (encode)
+            rc = alg == QORE_COMP_GZIP
+               ? deflateInit2(&zs, level, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY)
+               : deflateInit(&zs, level);
+         else
+            rc = alg == QORE_COMP_GZIP ? inflateInit2(&zs, 47) : inflateInit(&zs);
+         if (rc != Z_OK) {
+            do_zlib_exception(rc, encode ? "deflateInit" : "inflateInit", xsink);
+            return;
+         }
+      }
+      init = true;
+   }
+
+   // processes the next block of data and returns any output produced so far, which may be empty
+   DLLLOCAL BinaryNode* update(const void* ptr, qore_size_t len, ExceptionSink* xsink) {
+      return process(ptr, len, false, xsink);
+   }
+
+   // returns all compressed output pending for the data processed so far; the stream can still be used for more data
+   DLLLOCAL BinaryNode* flush(ExceptionSink* xsink) {
+      assert(encode);
+      return process(0, 0, false, xsink, true);
+   }
+
+   // processes any remaining data and returns the rest of the output; the stream cannot be used for more data afterwards
+   DLLLOCAL BinaryNode* finish(ExceptionSink* xsink) {
+      return process(0, 0, true, xsink);
+   }
+
+   // returns true if the end of the compressed stream has been reached
+   DLLLOCAL bool isDone() {
+      AutoLocker al(m);
+      return done;
+   }
+};
+
+#endif
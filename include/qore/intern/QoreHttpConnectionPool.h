@@ -0,0 +1,169 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  QoreHttpConnectionPool.h
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QOREHTTPCONNECTIONPOOL_H
+
+#define _QORE_QOREHTTPCONNECTIONPOOL_H
+
+#include <qore/QoreHttpClientObject.h>
+#include <qore/QoreThreadLock.h>
+#include <qore/QoreCondition.h>
+
+#include <map>
+#include <vector>
+#include <string>
+
+// default maximum number of connections for each scheme/host/port combination
+#define QORE_HTTP_POOL_DEFAULT_MAX 10
+// default time in milliseconds after which idle connections are closed instead of being reused
+#define QORE_HTTP_POOL_DEFAULT_MAX_IDLE_MS 30000
+
+// an idle connection in the pool
+struct HttpPoolConnection {
+   QoreHttpClientObject* client;
+   // the time the connection was returned to the pool with q_clock_getmillis()
+   int64 last_used;
+
+   DLLLOCAL HttpPoolConnection(QoreHttpClientObject* c, int64 t) : client(c), last_used(t) {
+   }
+};
+
+typedef std::vector<HttpPoolConnection> http_pool_conn_list_t;
+
+// connections and statistics for a single scheme/host/port combination
+struct HttpPoolHost {
+   // idle connections; the most recently used connection is at the end
+   http_pool_conn_list_t idle;
+   // number of connections currently in use
+   unsigned in_use;
+   int64 requests,
+      reused,
+      created,
+      evicted,
+      errors;
+
+   DLLLOCAL HttpPoolHost() : in_use(0), requests(0), reused(0), created(0), evicted(0), errors(0) {
+   }
+};
+
+typedef std::map<std::string, HttpPoolHost*> http_pool_host_map_t;
+
+// a pool of keep-alive HTTP connections shared between threads, keyed by scheme, host and port
+/* each request takes a connection for the target server from the pool (or creates a new one if the limit has not been
+   reached, otherwise waits for a connection to be returned), and puts it back when the response has been received;
+   connections that fail or that the server closes are not reused
+*/
+class QoreHttpConnectionPool : public AbstractPrivateData, public QoreCondition, public QoreThreadLock {
+protected:
+   http_pool_host_map_t hmap;
+   // HTTPClient options for new connections
+   QoreHashNode* opts;
+   // the scheme, credentials, host and port of the url option; used for requests with a relative path
+   std::string base_prefix;
+   // the path of the url option; used for requests without a path
+   std::string base_path;
+   // maximum number of connections per scheme/host/port
+   unsigned max;
+   // number of threads waiting for a connection
+   unsigned waiting;
+   // idle connections older than this are closed instead of being reused
+   int64 max_idle_ms;
+   // maximum time to wait for a free connection; 0 = wait indefinitely
+   int acquire_timeout_ms;
+   // statistics for all hosts
+   int64 stats_reqs,
+      stats_reused,
+      stats_created,
+      stats_evicted,
+      stats_errors,
+      stats_timeouts,
+      wait_max;
+   // false when the pool has been destroyed
+   bool valid;
+
+   DLLLOCAL virtual ~QoreHttpConnectionPool() {
+      assert(!opts);
+      for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+         assert(i->second->idle.empty());
+         assert(!i->second->in_use);
+         delete i->second;
+      }
+   }
+
+   // returns the host entry for the given key, creating it if necessary; must be called with the lock held
+   DLLLOCAL HttpPoolHost* getHost(const std::string& key) {
+      http_pool_host_map_t::iterator i = hmap.lower_bound(key);
+      if (i != hmap.end() && i->first == key)
+         return i->second;
+      HttpPoolHost* h = new HttpPoolHost;
+      hmap.insert(i, http_pool_host_map_t::value_type(key, h));
+      return h;
+   }
+
+   // determines the pool key, the full URL, the request path, and any credentials for the given path or URL argument
+   DLLLOCAL int getTarget(const char* path, std::string& key, std::string& url, std::string& rpath, std::string& user, std::string& pass, ExceptionSink* xsink) const;
+
+   // returns a connection for the given key; returns 0 if an exception was raised
+   DLLLOCAL QoreHttpClientObject* acquire(const std::string& key, const std::string& url, ExceptionSink* xsink);
+
+   // returns a connection to the pool if reuse is true and it's still connected, otherwise closes it
+   DLLLOCAL void release(const std::string& key, QoreHttpClientObject* client, bool reuse, bool error, ExceptionSink* xsink);
+
+   // returns true if an idle connection can be reused
+   DLLLOCAL static bool checkIdle(QoreHttpClientObject* client);
+
+   // closes the connection and releases the object
+   DLLLOCAL static void closeConnection(QoreHttpClientObject* client, ExceptionSink* xsink) {
+      client->cleanup(xsink);
+      client->deref(xsink);
+   }
+
+   // removes all idle connections from the pool and adds them to the given list; must be called with the lock held
+   DLLLOCAL void takeIdle(http_pool_conn_list_t& l);
+
+public:
+   DLLLOCAL QoreHttpConnectionPool(const QoreHashNode* n_opts, ExceptionSink* xsink);
+
+   // closes all idle connections and wakes up any threads waiting for a connection; connections in use are closed when
+   // they are returned
+   DLLLOCAL void destructor(ExceptionSink* xsink);
+
+   // sends an HTTP request on a connection from the pool; the path may be a path relative to the url option or a complete URL
+   DLLLOCAL QoreHashNode* send(const char* meth, const char* path, const QoreHashNode* headers, const void* data, unsigned size, bool getbody, QoreHashNode* info, ExceptionSink* xsink);
+
+   // closes all idle connections
+   DLLLOCAL void clearIdle(ExceptionSink* xsink);
+
+   // returns a hash of pool statistics
+   DLLLOCAL QoreHashNode* getStats();
+};
+
+#endif
@@ -310,6 +310,10 @@ enum qore_call_t {
 
 #define DAH_TEXT(d) (d == DAH_RELEASE ? "RELEASE" : (d == DAH_ACQUIRE ? "ACQUIRE" : "NOCHANGE"))
 
+// internal parse option only used when copying namespaces for QoreProgram::clone(): copy all objects
+// regardless of the public and inheritance flags
+#define PO_INTERN_CLONE (1LL << 62)
+
 DLLLOCAL int check_lvalue(AbstractQoreNode* n, bool assign = true);
 DLLLOCAL int check_lvalue_int(const QoreTypeInfo*& typeInfo, const char* name);
 DLLLOCAL int check_lvalue_float(const QoreTypeInfo*& typeInfo, const char* name);
@@ -151,7 +151,7 @@ public:
         var_list(old.var_list, po),
         depth(old.depth),
         root(old.root),
-        pub(old.builtin ? true : false),
+        pub((po & PO_INTERN_CLONE) ? old.pub : (old.builtin ? true : false)),
         builtin(old.builtin),
         imported(old.imported),
         parent(0), class_handler(old.class_handler), ns(0) {
@@ -36,42 +36,63 @@
 #include <qore/QoreThreadLock.h>
 #include <qore/QoreCondition.h>
 
-class QoreQueueNode {
-public:
-   AbstractQoreNode* node;
-   QoreQueueNode* prev,
-                * next;
+#include <vector>
+
+// initial size of the circular buffer for unbounded queues
+#define QUEUE_INITIAL_SIZE 16
+// bounded queues up to this size have their buffer allocated in full when created
+#define QUEUE_MAX_PREALLOC 4096
+
+#define QW_DEL     -1
+#define QW_TIMEOUT -2
 
-   DLLLOCAL QoreQueueNode(AbstractQoreNode* n, QoreQueueNode* p, QoreQueueNode* nx) : node(n), prev(p), next(nx) {
+// a waiter registered with one or more queues that is signaled whenever data is added to any of them
+class QoreQueueWaiter {
+protected:
+   QoreThreadLock m;
+   QoreCondition cond;
+   // incremented each time the waiter is signaled
+   int64 gen;
+
+public:
+   DLLLOCAL QoreQueueWaiter() : gen(0) {
    }
 
-#ifdef DEBUG
-   DLLLOCAL ~QoreQueueNode() {
-      assert(!node);
+   DLLLOCAL void signal() {
+      AutoLocker al(m);
+      ++gen;
+      cond.broadcast();
    }
-#endif
 
-   DLLLOCAL void del(ExceptionSink *xsink) {
-      if (node)
-         node->deref(xsink);
-#ifdef DEBUG
-      node = 0;
-#endif
-      delete this;
+   // returns the current generation; must be called before checking the queues for data
+   DLLLOCAL int64 getGeneration() {
+      AutoLocker al(m);
+      return gen;
    }
 
-   DLLLOCAL AbstractQoreNode* takeAndDel() {
-      AbstractQoreNode* rv = node;
-#ifdef DEBUG
-      node = 0;
-#endif
-      delete this;
-      return rv;
+   // waits until the waiter has been signaled since generation "g" was read; returns -1 if a timeout occurred
+   DLLLOCAL int wait(int64 g, int timeout_ms) {
+      // spurious wakeups must not restart the timeout
+      int64 end = timeout_ms ? q_clock_getmillis() + timeout_ms : 0;
+      AutoLocker al(m);
+      while (gen == g) {
+         int rc;
+         if (end) {
+            int64 left = end - q_clock_getmillis();
+            if (left <= 0)
+               return -1;
+            rc = cond.wait(m, (int)left);
+         }
+         else
+            rc = cond.wait(m);
+         if (rc && gen == g)
+            return -1;
+      }
+      return 0;
    }
 };
 
-#define QW_DEL     -1
-#define QW_TIMEOUT -2
+typedef std::vector<QoreQueueWaiter*> qwvec_t;
 
 class qore_queue_private {
 private:
@@ -80,50 +101,139 @@ private:
    mutable QoreThreadLock l;
    QoreCondition read_cond,   // read Condition variable
                  write_cond;  // write Condition variable
-   QoreQueueNode* head,
-                * tail;
-   int len,   // the number of elements currently in the queue (or -1 for deleted)
+   // circular buffer of queued values; elements are stored in place, so no memory is allocated for each element
+   AbstractQoreNode** buf;
+   int cap,   // the size of the buffer (always a power of 2)
+       min_cap, // the initial size of the buffer; the buffer is never shrunk below this size
+       first, // the offset of the first element in the buffer
+       len,   // the number of elements currently in the queue (or -1 for deleted)
        max;   // the maximum size of the queue (or -1 for unlimited)
    unsigned read_waiting,   // number of threads waiting on reads
             write_waiting;  // number of threads waiting on writes
+   // waiters for queue sets including this queue
+   qwvec_t waiters;
 
    DLLLOCAL int waitReadIntern(ExceptionSink *xsink, int timeout_ms);
    DLLLOCAL int waitWriteIntern(ExceptionSink *xsink, int timeout_ms);
 
+   // returns the buffer offset of the element with the given index
+   DLLLOCAL int pos(int i) const {
+      return (first + i) & (cap - 1);
+   }
+
+   // allocates the initial buffer
+   DLLLOCAL void init() {
+      cap = QUEUE_INITIAL_SIZE;
+      if (max > 0 && max <= QUEUE_MAX_PREALLOC)
+         while (cap < max)
+            cap <<= 1;
+      min_cap = cap;
+      buf = new AbstractQoreNode*[cap];
+   }
+
+   // reallocates the buffer with the given size and copies the elements in order to the start of the new buffer
+   DLLLOCAL void resizeIntern(int ncap);
+
+   // makes sure there is room for another element in the buffer
+   DLLLOCAL void reserveIntern() {
+      if (len == cap)
+         resizeIntern(cap << 1);
+   }
+
+   // halves the buffer when it is no more than a quarter full, so a burst of data does not keep the peak
+   // allocation for the lifetime of the queue; the remaining space avoids resizing again on the next push
+   DLLLOCAL void shrinkIntern() {
+      if (cap > min_cap && len <= (cap >> 2))
+         resizeIntern(cap >> 1);
+   }
+
    DLLLOCAL void pushNode(AbstractQoreNode* v);
    DLLLOCAL void pushIntern(AbstractQoreNode* v);
    DLLLOCAL void insertIntern(AbstractQoreNode* v);
 
+   // removes and returns the first element; the queue must not be empty
+   DLLLOCAL AbstractQoreNode* shiftNode() {
+      assert(len > 0);
+      AbstractQoreNode* rv = buf[first];
+      first = (first + 1) & (cap - 1);
+      --len;
+      shrinkIntern();
+      return rv;
+   }
+
+   // removes and returns the last element; the queue must not be empty
+   DLLLOCAL AbstractQoreNode* popNode() {
+      assert(len > 0);
+      AbstractQoreNode* rv = buf[pos(--len)];
+      shrinkIntern();
+      return rv;
+   }
+
    DLLLOCAL void clearIntern(ExceptionSink* xsink);
 
+   DLLLOCAL void signalWaitersIntern() {
+      for (qwvec_t::iterator i = waiters.begin(), e = waiters.end(); i != e; ++i)
+         (*i)->signal();
+   }
+
 public:
-   DLLLOCAL qore_queue_private(int n_max = -1) : head(0), tail(0), len(0), max(n_max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(int n_max = -1) : first(0), len(0), max(n_max), read_waiting(0), write_waiting(0) {
       assert(max);
+      init();
       //printd(5, "qore_queue_private::qore_queue_private() this: %p max: %d\n", this, max);
    }
 
-   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : head(0), tail(0), len(0), max(orig.max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : first(0), len(0), max(orig.max), read_waiting(0), write_waiting(0) {
+      init();
       AutoLocker al(orig.l);
       if (orig.len == Queue_Deleted)
          return;
-      
-      QoreQueueNode* w = orig.head;
-      while (w) {
-         pushIntern(w->node ? w->node->refSelf() : 0);
-         w = w->next;
+
+      for (int i = 0; i < orig.len; ++i) {
+         AbstractQoreNode* n = orig.buf[orig.pos(i)];
+         pushNode(n ? n->refSelf() : 0);
       }
 
-      //printd(5, "qore_queue_private::qore_queue_private() this=%p head=%p tail=%p waiting=%d len=%d\n", this, head, tail, waiting, len);
+      //printd(5, "qore_queue_private::qore_queue_private() this=%p len=%d\n", this, len);
    }
 
    // queues should not be deleted when other threads might
    // be accessing them
    DLLLOCAL ~qore_queue_private() {
       //QORE_TRACE("qore_queue_private::~qore_queue_private()");
-      //printd(5, "qore_queue_private::~qore_queue_private() this=%p head=%p tail=%p len=%d\n", this, head, tail, len);
-      assert(!head);
-      assert(!tail);
+      //printd(5, "qore_queue_private::~qore_queue_private() this=%p len=%d\n", this, len);
       assert(len == Queue_Deleted);
+      assert(waiters.empty());
+      delete [] buf;
+   }
+
+   // removes the first element without blocking; returns 0 if an element was removed, -1 if the queue is empty, or QW_DEL if the queue has been deleted
+   DLLLOCAL int tryShift(AbstractQoreNode*& rv) {
+      AutoLocker al(&l);
+      if (len == Queue_Deleted)
+         return QW_DEL;
+      if (!len)
+         return -1;
+      rv = shiftNode();
+      if (write_waiting)
+         write_cond.signal();
+      return 0;
+   }
+
+   // registers a waiter to be signaled when data is added to the queue
+   DLLLOCAL void addWaiter(QoreQueueWaiter* w) {
+      AutoLocker al(&l);
+      waiters.push_back(w);
+   }
+
+   DLLLOCAL void removeWaiter(QoreQueueWaiter* w) {
+      AutoLocker al(&l);
+      for (qwvec_t::iterator i = waiters.begin(), e = waiters.end(); i != e; ++i) {
+         if (*i == w) {
+            waiters.erase(i);
+            break;
+         }
+      }
    }
 
    // push at the end of the queue and take the reference - can only be used when len == -1
@@ -136,6 +246,12 @@ public:
    DLLLOCAL void insert(ExceptionSink* xsink, const AbstractQoreNode* n, int timeout_ms = 0, bool *to = 0);
 
    DLLLOCAL AbstractQoreNode* shift(ExceptionSink* xsink, int timeout_ms = 0, bool *to = 0);
+
+   // push all elements of the list at the end of the queue
+   DLLLOCAL void pushList(ExceptionSink* xsink, const QoreListNode* lst, int timeout_ms = 0, bool* to = 0);
+
+   // remove up to "n" elements from the beginning of the queue (all available elements if n <= 0)
+   DLLLOCAL QoreListNode* shiftList(ExceptionSink* xsink, int n, int timeout_ms = 0, bool* to = 0);
    DLLLOCAL AbstractQoreNode* pop(ExceptionSink* xsink, int timeout_ms = 0, bool *to = 0);
 
    DLLLOCAL bool empty() const {
@@ -164,6 +280,10 @@ public:
    DLLLOCAL static void destructor(QoreQueue& q, ExceptionSink* xsink) {
       q.priv->destructor(xsink);
    }
+
+   DLLLOCAL static qore_queue_private* get(QoreQueue& q) {
+      return q.priv;
+   }
 };
 
 #endif // _QORE_QOREQUEUEINTERN_H
@@ -33,10 +33,17 @@
 
 #define _QORE_QORETHREADLIST_H
 
-// FIXME: move to config.h or something like that
-// not more than this number of threads can be running at the same time
+// thread entries are allocated in segments of this many entries as they are needed
+#define QORE_THREAD_SEGMENT_BITS 10
+#define QORE_THREAD_SEGMENT_SIZE (1 << QORE_THREAD_SEGMENT_BITS)
+// the size of the segment table; segments are never moved or freed while the library is initialized so that
+// thread entries can be looked up by TID without locking
+#define QORE_THREAD_MAX_SEGMENTS 0x400
+
+// not more than this number of threads can be running at the same time; by default the limit is only given by the
+// size of the segment table (1048576 threads), so the number of threads is effectively limited only by system resources
 #ifndef MAX_QORE_THREADS
-#define MAX_QORE_THREADS 0x1000
+#define MAX_QORE_THREADS (QORE_THREAD_SEGMENT_SIZE * QORE_THREAD_MAX_SEGMENTS)
 #endif
 
 class ThreadData;
@@ -59,6 +66,13 @@ class CallNode;
 #define MAX_QORE_THREADS 2560
 #endif
 
+// the effective limit on the number of TIDs that can be issued
+#if MAX_QORE_THREADS < QORE_THREAD_SEGMENT_SIZE * QORE_THREAD_MAX_SEGMENTS
+#define QORE_THREAD_TID_LIMIT MAX_QORE_THREADS
+#else
+#define QORE_THREAD_TID_LIMIT (QORE_THREAD_SEGMENT_SIZE * QORE_THREAD_MAX_SEGMENTS)
+#endif
+
 class tid_node {
 public:
    int tid;
@@ -77,6 +91,8 @@ public:
    CallStack* callStack;
 #endif
    ThreadData* thread_data;
+   // the next TID in the free list
+   int next_free;
    unsigned char status;
    bool joined; // if set to true then pthread_detach should not be called on exit
 
@@ -101,57 +117,97 @@ friend class tid_node;
 protected:
    mutable QoreThreadLock l;
    unsigned num_threads;
-   ThreadEntry entry[MAX_QORE_THREADS];
+   // thread entry segments; only the first "num_segments" entries are allocated
+   ThreadEntry* segment[QORE_THREAD_MAX_SEGMENTS];
+   unsigned num_segments;
 
    tid_node* tid_head, * tid_tail;
 
    // current TID to be issued next
    int current_tid;
 
+   // FIFO list of released TIDs linked with ThreadEntry::next_free; 0 = empty since TID 0 is never released to the list
+   int free_head, free_tail;
+
    bool exiting;
 
+   DLLLOCAL ThreadEntry& entry(int tid) const {
+      assert(tid >= 0 && (unsigned)tid < (num_segments << QORE_THREAD_SEGMENT_BITS));
+      return segment[tid >> QORE_THREAD_SEGMENT_BITS][tid & (QORE_THREAD_SEGMENT_SIZE - 1)];
+   }
+
+   // allocates a new segment of thread entries; returns -1 if the segment table is full
+   DLLLOCAL int addSegmentIntern() {
+      if (num_segments == QORE_THREAD_MAX_SEGMENTS)
+         return -1;
+      // value-initialize the entries so they are all available (QTS_AVAIL)
+      segment[num_segments] = new ThreadEntry[QORE_THREAD_SEGMENT_SIZE]();
+      ++num_segments;
+      return 0;
+   }
+
    DLLLOCAL void releaseIntern(int tid) {
       // NOTE: cannot safely call printd here, because normally the thread_data has been deleted
       //printf("DEBUG: ThreadList.releaseIntern() TID %d terminated\n", tid);
-      entry[tid].cleanup();
-      if (tid)
+      ThreadEntry& te = entry(tid);
+      te.cleanup();
+      if (tid) {
          --num_threads;
+         // append to the free list so that released TIDs are reused as late as possible
+         te.next_free = 0;
+         if (free_tail)
+            entry(free_tail).next_free = tid;
+         else
+            free_head = tid;
+         free_tail = tid;
+      }
    }
 
 public:
-   DLLLOCAL QoreThreadList() : num_threads(0), tid_head(0), tid_tail(0), current_tid(1), exiting(false) {
+   DLLLOCAL QoreThreadList() : num_threads(0), num_segments(0), tid_head(0), tid_tail(0), current_tid(1), free_head(0), free_tail(0), exiting(false) {
+      addSegmentIntern();
+   }
+
+   DLLLOCAL ~QoreThreadList() {
+      for (unsigned i = 0; i < num_segments; ++i)
+         delete [] segment[i];
    }
 
    DLLLOCAL int get(int status = QTS_NA) {
-      int tid = -1;
+      int tid;
       AutoLocker al(l);
 
-      if (current_tid == MAX_QORE_THREADS) {
-         int i;
-         // scan thread_list for free entry
-         for (i = 1; i < MAX_QORE_THREADS; i++) {
-            if (entry[i].available()) {
-               tid = i;
-               goto finish;
-            }
-         }
-         if (i == MAX_QORE_THREADS)
-            return -1;
+      // new TIDs are issued until all allocated entries have been used once, then released TIDs are reused, and
+      // only if there are none is a new segment allocated, so the table only grows with the peak number of threads
+      if ((unsigned)current_tid < (num_segments << QORE_THREAD_SEGMENT_BITS) && current_tid < QORE_THREAD_TID_LIMIT)
+         tid = current_tid++;
+      else if (free_head) {
+         tid = free_head;
+         free_head = entry(tid).next_free;
+         if (!free_head)
+            free_tail = 0;
       }
-      else
+      else if (current_tid < QORE_THREAD_TID_LIMIT && !addSegmentIntern())
          tid = current_tid++;
+      else
+         return -1;
 
-   finish:
-      entry[tid].allocate(new tid_node(tid), status);
+      assert(entry(tid).available());
+      entry(tid).allocate(new tid_node(tid), status);
       ++num_threads;
       //printf("t%d cs=0\n", tid);
 
       return tid;
    }
 
+   // returns true if the TID has been issued at least once; the thread entry can be accessed without locking
+   DLLLOCAL bool valid(int tid) const {
+      return tid >= 0 && tid < current_tid;
+   }
+
    DLLLOCAL int getSignalThreadEntry() {
       AutoLocker al(l);
-      entry[0].allocate(0);
+      entry(0).allocate(0);
       return 0;
    }
 
@@ -162,7 +218,7 @@ public:
 
    DLLLOCAL int releaseReserved(int tid) {
       AutoLocker al(l);
-      if (entry[tid].status != QTS_RESERVED)
+      if (entry(tid).status != QTS_RESERVED)
          return -1;
 
       releaseIntern(tid);
@@ -171,13 +227,13 @@ public:
 
    DLLLOCAL void activate(int tid, pthread_t ptid = pthread_self(), QoreProgram* p = 0, bool foreign = false) {
       AutoLocker al(l);
-      entry[tid].activate(tid, ptid, p, foreign);
+      entry(tid).activate(tid, ptid, p, foreign);
    }
 
    DLLLOCAL void setStatus(int tid, int status) {
       AutoLocker al(l);
-      assert(entry[tid].status != status);
-      entry[tid].status = status;
+      assert(entry(tid).status != status);
+      entry(tid).status = status;
    }
 
    DLLLOCAL void deleteData(int tid);
@@ -189,10 +245,10 @@ public:
    DLLLOCAL int activateReserved(int tid) {
       AutoLocker al(l);
 
-      if (entry[tid].status != QTS_RESERVED)
+      if (entry(tid).status != QTS_RESERVED)
          return -1;
 
-      entry[tid].activate(tid, pthread_self(), 0, true);
+      entry(tid).activate(tid, pthread_self(), 0, true);
       return 0;
    }
 
@@ -204,16 +260,6 @@ public:
 
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
    DLLLOCAL QoreHashNode* getAllCallStacks();
-
-   DLLLOCAL void pushCall(CallNode* cn);
-
-   DLLLOCAL void popCall(ExceptionSink* xsink);
-
-   DLLLOCAL QoreListNode* getCallStackList();
-
-   DLLLOCAL CallStack* getCallStack() {
-      return entry[gettid()].callStack;
-   }
 #endif
 
 };
@@ -231,7 +277,7 @@ public:
    DLLLOCAL bool next() {
       do {
          w = w ? w->next : thread_list.tid_head;
-      } while (w && (!w->tid || (thread_list.entry[w->tid].status != QTS_ACTIVE)));
+      } while (w && (!w->tid || (thread_list.entry(w->tid).status != QTS_ACTIVE)));
 
       return (bool)w;
    }
@@ -43,11 +43,35 @@
 // to track TIDs and read counts of readers
 typedef std::map<int, int> tid_map_t;
 
+// maximum number of reader stripes for reader-biased locks
+#define QORE_RWLOCK_MAX_STRIPES 64
+
+// reader state for a subset of threads in a reader-biased lock
+/* each stripe has its own lock and is padded to its own cache line(s), so readers in different
+   threads do not contend on the same mutex or cache line
+*/
+struct RWLockStripe {
+   QoreThreadLock m;
+   int num_readers;    // number of read locks held by threads in this stripe
+   tid_map_t tmap;     // map of TIDs to read lock counts
+   vlock_map_t vmap;   // map of TIDs to VLock data structures
+   char pad[64];
+
+   DLLLOCAL RWLockStripe() : num_readers(0) {
+   }
+};
+
 // ASL mapping:
 // asl_cond: write cond
 // waiting: waiting write requests
 // tid: write TID
 
+// reader-biased mode:
+/* readers are tracked in per-thread stripes and acquire the read lock by taking only their stripe's lock as long
+   as no writer is pending; a writer sets write_pending under asl_lock, which forces all new readers to the slow path
+   (and therefore gives writers priority over new readers), and then waits for the readers in all stripes to drain.
+   Lock order is always asl_lock -> stripe lock.
+*/
 class RWLock : public AbstractSmartLock {
 private:
    int readRequests;
@@ -57,6 +81,35 @@ private:
    vlock_map_t vmap;   // map of TIDs to VLock data structures
    int num_readers;    // number of threads holding the read lock
 
+   // reader-biased mode: reader stripes or 0 if not reader-biased
+   RWLockStripe* stripes;
+   unsigned num_stripes;
+   // reader-biased mode: set while a writer is waiting for readers to drain or holds the write lock
+   volatile bool write_pending;
+   // reader-biased mode: the VLock of the writer waiting for readers to drain
+   VLock* pending_vl;
+
+   DLLLOCAL RWLockStripe& getStripe(int mtid) const {
+      return stripes[mtid & (num_stripes - 1)];
+   }
+
+   // reader-biased mode: acquires the read lock if no writer is pending or the thread already holds the read lock
+   DLLLOCAL int try_stripe_read_lock_intern(int mtid, VLock* nvl);
+   // reader-biased mode: must be called with the stripe's lock held
+   DLLLOCAL void mark_stripe_read_lock_intern(RWLockStripe& s, int mtid, VLock* nvl);
+   // reader-biased mode: must be called with the stripe's lock held; 0 = last read lock in this thread released
+   DLLLOCAL int release_stripe_read_lock_intern(RWLockStripe& s, tid_map_t::iterator i);
+   // reader-biased mode: must be called with asl_lock held
+   DLLLOCAL int grab_biased_read_lock_intern(int mtid, VLock* nvl, int64 timeout_ms, ExceptionSink* xsink);
+   DLLLOCAL int grab_biased_write_lock_intern(int mtid, VLock* nvl, ExceptionSink* xsink, int64 timeout_ms);
+   // reader-biased mode: if fast is true, returns 1 without releasing the lock if a writer is pending
+   DLLLOCAL int release_biased_read_lock_intern(int mtid, ExceptionSink* xsink, bool fast);
+   DLLLOCAL int extern_biased_read_wait_intern(int mtid, QoreCondition* cond, ExceptionSink* xsink, int64 timeout_ms);
+   // returns the read lock holders in all stripes
+   DLLLOCAL void get_readers_intern(vlock_map_t& rmap) const;
+   DLLLOCAL void cancel_write_pending_intern();
+   DLLLOCAL bool readLockOwnerBiased() const;
+
    // 0 = last read lock in this thread released
    DLLLOCAL int cleanup_read_lock_intern(tid_map_t::iterator i);
    DLLLOCAL void mark_read_lock_intern(int mtid, VLock *nvl);
@@ -77,11 +130,9 @@ private:
 protected:
 
 public:
-   DLLLOCAL RWLock(bool p = false);
+   DLLLOCAL RWLock(bool p = false, bool reader_biased = false);
 
-#ifdef DEBUG
    DLLLOCAL virtual ~RWLock();
-#endif
 
    DLLLOCAL int readLock(ExceptionSink *xsink, int64 timeout_ms = 0);
    DLLLOCAL int readUnlock(ExceptionSink *xsink);
@@ -90,6 +141,10 @@ public:
 
    DLLLOCAL int numReaders();
 
+   DLLLOCAL bool isReaderBiased() const {
+      return stripes ? true : false;
+   }
+
    DLLLOCAL int getReadWaiting() const {
       return readRequests;
    }
@@ -109,6 +164,9 @@ public:
    }
 
    DLLLOCAL bool readLockOwner() const {
+      if (stripes)
+         return readLockOwnerBiased();
+
       // if the write lock is held or the lock is deleted or nobody has the read lock, then return false
       if (tid > -1 || tid == Lock_Deleted || !num_readers)
          return false;
@@ -32,47 +32,149 @@
 
 #define QTP_DEFAULT_RELEASE_MS 5000
 
+// tasks submitted by a pool's own worker threads are queued locally when a full barrier is available
+#ifdef __GNUC__
+#define QORE_TP_LOCAL_QUEUE 1
+#define qore_tp_barrier() __sync_synchronize()
+#endif
+
 #include <deque>
+#include <vector>
 #include <qore/qlist>
 
+DLLLOCAL extern qore_classid_t CID_FUTURE;
+DLLLOCAL extern QoreClass* QC_FUTURE;
+
 class ThreadTask;
 class ThreadPoolThread;
+class ThreadPool;
+class QoreFutureWaiter;
 
 typedef std::deque<ThreadTask*> taskq_t;
 typedef qlist<ThreadPoolThread*> tplist_t;
+typedef std::vector<ThreadTask*> ttvec_t;
+typedef std::vector<QoreFutureWaiter*> fwvec_t;
+
+// the result of a task submitted with ThreadPool::submitFuture() or registered with Future::then()
+class QoreFuture : public AbstractPrivateData {
+protected:
+   // mutex for atomicity
+   QoreThreadLock m;
+
+   // condition variable for threads waiting on the result
+   QoreCondition cond;
+
+   // the ThreadPool for continuations
+   ThreadPool* tp;
+
+   // the result value
+   AbstractQoreNode* result;
+
+   // the exception raised by the task, if any
+   QoreException* ex;
+
+   // continuations to submit to the ThreadPool when the result is available
+   ttvec_t conts;
+
+   // threads waiting in Future::waitAny()
+   fwvec_t waiters;
+
+   // set when the result is available
+   bool done;
+
+   DLLLOCAL virtual ~QoreFuture() {
+      assert(!result);
+      assert(!ex);
+      assert(conts.empty());
+      assert(waiters.empty());
+   }
+
+   // submits or fails a continuation once the result is available
+   DLLLOCAL void runContinuation(ThreadTask* t, ExceptionSink* xsink);
+
+   // waits for the result; returns -1 if a timeout occurred
+   DLLLOCAL int waitDone(int timeout_ms);
+
+public:
+   DLLLOCAL QoreFuture(ThreadPool* n_tp);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink);
+
+   // sets the result value (which is consumed) and any exception in "xs" and submits any continuations
+   DLLLOCAL void complete(AbstractQoreNode* rv, ExceptionSink& xs, ExceptionSink* xsink);
+
+   // waits for and returns the result or raises the task's exception
+   DLLLOCAL AbstractQoreNode* get(int timeout_ms, ExceptionSink* xsink);
+
+   DLLLOCAL bool isDone() {
+      AutoLocker al(m);
+      return done;
+   }
+
+   // returns the result value for a continuation; must only be called after the Future has completed without an exception
+   DLLLOCAL AbstractQoreNode* getResult() const {
+      assert(done && !ex);
+      return result ? result->refSelf() : 0;
+   }
+
+   // registers a continuation and returns the new Future object for its result
+   DLLLOCAL QoreObject* then(ResolvedCallReferenceNode* c, ExceptionSink* xsink);
+
+   // returns the index of the first Future that has completed or -1 if a timeout occurred
+   DLLLOCAL static int waitAny(const std::vector<QoreFuture*>& fl, int timeout_ms);
+};
 
 class ThreadTask {
 protected:
    ResolvedCallReferenceNode* code;
    ResolvedCallReferenceNode* cancelCode;
-   
+   // the Future for the task's result, if any
+   QoreFuture* future;
+   // the Future providing the argument for continuations, if any
+   QoreFuture* src;
+
+   DLLLOCAL void runFuture(ExceptionSink* xsink);
+
 public:
-   DLLLOCAL ThreadTask(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc) : code(c), cancelCode(cc) {
+   DLLLOCAL ThreadTask(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc, QoreFuture* f = 0, QoreFuture* s = 0) : code(c), cancelCode(cc), future(f), src(s) {
    }
 
    DLLLOCAL ~ThreadTask() {
       assert(!code);
       assert(!cancelCode);
+      assert(!future);
+      assert(!src);
    }
 
    DLLLOCAL void del(ExceptionSink* xsink) {
       code->deref(xsink);
       if (cancelCode)
          cancelCode->deref(xsink);
+      if (future)
+         future->deref(xsink);
+      if (src)
+         src->deref(xsink);
 #ifdef DEBUG
       code = 0;
       cancelCode = 0;
+      future = 0;
+      src = 0;
 #endif
       delete this;
    }
 
    DLLLOCAL QoreValue run(ExceptionSink* xsink) {
+      if (future) {
+         runFuture(xsink);
+         return QoreValue();
+      }
       return code->execValue(0, xsink);
    }
 
-   DLLLOCAL void cancel(ExceptionSink* xsink) {
-      if (cancelCode)
-         cancelCode->execValue(0, xsink).discard(xsink);
+   DLLLOCAL void cancel(ExceptionSink* xsink);
+
+   DLLLOCAL QoreFuture* getFuture() const {
+      return future;
    }
 };
 
@@ -98,8 +200,6 @@ public:
    }
 };
 
-class ThreadPool;
-
 class ThreadPoolThread {
 protected:
    int id;
@@ -109,17 +209,23 @@ protected:
       *stopCond;
    QoreThreadLock m;
    tplist_t::iterator pos;
+   // local task queue for tasks submitted by tasks running in this thread; the owner takes from the back, other threads steal from the front
+   taskq_t lq;
    bool stopflag,
       stopped;
 
    DLLLOCAL void finalize(ExceptionSink* xsink);
 
+   // cancels any tasks left in the local queue; must be called in the worker thread without the lock held
+   DLLLOCAL void cancelLocal(ExceptionSink* xsink);
+
 public:
    DLLLOCAL ThreadPoolThread(ThreadPool& n_tp, ExceptionSink* xsink);
 
    DLLLOCAL ~ThreadPoolThread() {
       delete stopCond;
       assert(!task);
+      assert(lq.empty());
    }
 
    DLLLOCAL void setPos(tplist_t::iterator p) {
@@ -172,6 +278,39 @@ public:
       c.signal();
    }
 
+   // queues a task submitted by a task running in this thread; returns -1 if the thread is stopping
+   DLLLOCAL int submitLocal(ThreadTask* t) {
+      AutoLocker al(m);
+      if (stopflag)
+         return -1;
+      lq.push_back(t);
+      return 0;
+   }
+
+   // removes a task from the local queue: the oldest when stealing, otherwise the newest
+   DLLLOCAL ThreadTask* takeLocal(bool steal) {
+      AutoLocker al(m);
+      if (lq.empty())
+         return 0;
+      ThreadTask* t;
+      if (steal) {
+         t = lq.front();
+         lq.pop_front();
+      }
+      else {
+         t = lq.back();
+         lq.pop_back();
+      }
+      return t;
+   }
+
+   DLLLOCAL bool inPool(const ThreadPool* p) const {
+      return &tp == p;
+   }
+
+   // returns the ThreadPoolThread for the current thread, if any
+   DLLLOCAL static ThreadPoolThread* current();
+
    DLLLOCAL int getId() const {
       return id;
    }
@@ -209,6 +348,10 @@ protected:
    // task waiting flag
    bool waiting;
 
+   // set when a submitted task can be started without waiting: either there are idle threads or new threads can be started;
+   // written with the lock held, read without the lock by worker threads submitting tasks to their local queues
+   volatile int spare;
+
    bool stopflag,   // stop flag
       stopped,      // stopped flag
       confirm;      // confirm member thread stop
@@ -234,9 +377,32 @@ protected:
       // set to an invalid iterator
       tpt->setPos(fh.end());
 #endif
+      updateSpareUnlocked();
       return 0;
    }
 
+   DLLLOCAL void updateSpareUnlocked() {
+      spare = !fh.empty() || !max || ((int)ah.size() + (int)fh.size() < max);
+   }
+
+   // steals the oldest task from the local queue of another running thread
+   DLLLOCAL ThreadTask* stealUnlocked(ThreadPoolThread* self) {
+      for (tplist_t::iterator i = ah.begin(), e = ah.end(); i != e; ++i) {
+         if (*i == self)
+            continue;
+         ThreadTask* t = (*i)->takeLocal(true);
+         if (t)
+            return t;
+      }
+      return 0;
+   }
+
+   DLLLOCAL void queueUnlocked(ThreadTask* t) {
+      if (q.empty())
+         cond.signal();
+      q.push_back(t);
+   }
+
    DLLLOCAL ThreadPoolThread* getThreadUnlocked(ExceptionSink* xsink) {
       while (!stopflag && fh.empty() && max && (int)ah.size() == max) {
 	 waiting = true;
@@ -266,9 +432,20 @@ protected:
       tplist_t::iterator i = ah.end();
       --i;
       tpt->setPos(i);
+      updateSpareUnlocked();
       return tpt;
    }
 
+   // returns a thread allocated with getThreadUnlocked() to the idle list
+   DLLLOCAL void releaseThreadUnlocked(ThreadPoolThread* tpt) {
+      ah.erase(tpt->getPos());
+      fh.push_back(tpt);
+#ifdef DEBUG
+      tpt->setPos(fh.end());
+#endif
+      updateSpareUnlocked();
+   }
+
 public:
    DLLLOCAL ThreadPool(ExceptionSink* xsink, int n_max = 0, int n_minidle = 0, int m_maxidle = 0, int n_release_ms = QTP_DEFAULT_RELEASE_MS);
 
@@ -333,15 +510,41 @@ public:
 
    DLLLOCAL int submit(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc, ExceptionSink* xsink) {
       // optimistically create the task object outside the lock
-      ThreadTaskHolder task(new ThreadTask(c, cc), xsink);
+      return submit(new ThreadTask(c, cc), xsink);
+   }
+
+   // submits a task and returns the new Future object for its result
+   DLLLOCAL QoreObject* submitFuture(ResolvedCallReferenceNode* c, ResolvedCallReferenceNode* cc, ExceptionSink* xsink);
+
+   // submits a task; the task is deleted if it cannot be submitted
+   DLLLOCAL int submit(ThreadTask* t, ExceptionSink* xsink) {
+      ThreadTaskHolder task(t, xsink);
+
+#ifdef QORE_TP_LOCAL_QUEUE
+      // tasks submitted from one of our own threads while no thread is available are queued locally without the pool lock
+      if (!spare && !stopflag) {
+         ThreadPoolThread* tpt = ThreadPoolThread::current();
+         if (tpt && tpt->inPool(this) && !tpt->submitLocal(task.release())) {
+            // make sure that a thread becoming free either sees the task or is seen here
+            qore_tp_barrier();
+            if (!spare)
+               return 0;
+
+            // a thread has become available in the meantime; move the task to the pool queue if it's still there
+            AutoLocker al(m);
+            ThreadTask* t = tpt->takeLocal(false);
+            if (t)
+               queueUnlocked(t);
+            return 0;
+         }
+      }
+#endif
 
       AutoLocker al(m);
       if (checkStopUnlocked("submit", xsink))
 	  return -1;
 
-      if (q.empty())
-	 cond.signal();
-      q.push_back(task.release());
+      queueUnlocked(task.release());
 
       return 0;
    }
@@ -352,7 +555,9 @@ public:
       running = ah.size();
    }
 
-   DLLLOCAL int done(ThreadPoolThread* tpt) {
+   // called when a thread has finished its task; returns 0 if the thread should continue, in which case
+   // "next" is set if the thread should run another task immediately, or -1 if the thread should terminate
+   DLLLOCAL int done(ThreadPoolThread* tpt, ThreadTask*& next) {
       {
 	 AutoLocker al(m);
          // allow the thread to be removed from the active list by ThreadPool::worker() to avoid race conditions
@@ -360,16 +565,36 @@ public:
             return 0;
 
 	 if (!confirm) {
+            // take the next task directly from the pool queue without returning the thread to the idle list
+            if (!q.empty()) {
+               next = q.front();
+               q.pop_front();
+               return 0;
+            }
+
+#ifdef QORE_TP_LOCAL_QUEUE
+            // announce that a thread is becoming available before looking in the local queues of other threads
+            spare = 1;
+            qore_tp_barrier();
+#endif
+            next = stealUnlocked(tpt);
+            if (next) {
+               updateSpareUnlocked();
+               return 0;
+            }
+
 	    tplist_t::iterator i = tpt->getPos();
 	    ah.erase(i);
-	    
+
             // requeue thread if possible
             if ((!maxidle && release_ms) || ((int)fh.size() < maxidle) || q.size() > fh.size()) {
                fh.push_back(tpt);
+               updateSpareUnlocked();
                if (waiting || (release_ms && (int)fh.size() > minidle))
                   cond.signal();
                return 0;
             }
+            updateSpareUnlocked();
 	 }
       }
 
@@ -36,33 +36,50 @@
 #include <qore/Qore.h>
 #include <qore/intern/AbstractSmartLock.h>
 
-#include <vector>
 #include <map>
 
 typedef std::map<int, class VLock *> vlock_map_t;
 
-// testing shows that a vector is slightly faster than a deque for this usage
-// and must faster than a list
-typedef std::vector<AbstractSmartLock *> abstract_lock_list_t;
+// number of held locks that can be tracked without allocating memory
+#define QORE_VLOCK_FIXED 16
+
+// time in milliseconds that a thread waits for a lock before checking for deadlocks
+#ifndef QORE_VLOCK_CHECK_MS
+#define QORE_VLOCK_CHECK_MS 10
+#endif
 
 // for tracking locks per thread and detecting deadlocks
-class VLock : protected abstract_lock_list_t
-{
+/* deadlock detection is deferred: a thread blocking on a lock first waits for QORE_VLOCK_CHECK_MS without checking
+   for deadlocks; only if the lock is still not available is the "waiting-on" graph checked, so the normal case of a
+   briefly-contended lock does not pay for deadlock detection
+*/
+class VLock {
    private:
       AbstractSmartLock *waiting_on;   // the lock this object is waiting on
+      // if set, the short wait for this lock has timed out, so deadlocks are checked on the next wait
+      AbstractSmartLock *check_on;
       int tid;
+      unsigned waits;                  // the number of times this thread has blocked on a lock
+      // the locks held by this thread in the order they were acquired
+      AbstractSmartLock **held;
+      unsigned len, cap;
+      AbstractSmartLock *fixed[QORE_VLOCK_FIXED];
 
       // not implemented
       VLock(const VLock&);
       VLock& operator=(const VLock&);
-      
+
+      // returns the other thread in a deadlock with this thread or 0 if there is none
+      DLLLOCAL VLock *checkDeadlock(VLock *vl) const;
+
+      DLLLOCAL int waitIntern(AbstractSmartLock *asl, QoreCondition *cond, VLock *vl, vlock_map_t *vmap, ExceptionSink *xsink, int timeout_ms);
+
    public:
       DLLLOCAL VLock(int n_tid);
       DLLLOCAL ~VLock();
       DLLLOCAL void push(AbstractSmartLock *g);
       DLLLOCAL int pop(AbstractSmartLock *asl);
-      DLLLOCAL void del();
-      DLLLOCAL AbstractSmartLock *find(AbstractSmartLock *g) const; 
+      DLLLOCAL AbstractSmartLock *find(AbstractSmartLock *g) const;
 
       // for blocking smart locks with deadlock detection
       DLLLOCAL int waitOn(AbstractSmartLock *asl, class VLock *vl, class ExceptionSink *xsink, int timeout_ms = 0);
@@ -71,9 +88,10 @@ class VLock : protected abstract_lock_list_t
       // for smart locks that can be held by more than one thread
       DLLLOCAL int waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, class ExceptionSink *xsink, int timeout_ms = 0);
       DLLLOCAL int getTID() const { return tid; }
-         
+      DLLLOCAL unsigned getWaits() const { return waits; }
+
 #ifdef DEBUG
-      DLLLOCAL void show(class VLock *nvl) const; 
+      DLLLOCAL void show(class VLock *nvl) const;
 #endif
 };
 
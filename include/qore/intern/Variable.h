@@ -107,12 +107,18 @@ private:
    const QoreTypeInfo *typeInfo;
    bool pub,                          // is this global var public (valid and set for modules only)
       finalized;                      // has this var already been cleared during Program destruction?
+   // index in the variable table of program clones, -1 if the program has never been cloned; written once with the
+   // source program's plock held and read without locking at runtime, so it must be read with a single load
+   volatile int clone_slot;
 
    DLLLOCAL void del(ExceptionSink* xsink);
 
    // not implemented
    DLLLOCAL Var(const Var&);
 
+   // used by copy(); the second argument is only used to distinguish this constructor from the copy constructor
+   DLLLOCAL Var(const Var& old, bool);
+
 protected:
    DLLLOCAL ~Var() { delete parseTypeInfo; }
 
@@ -125,20 +131,35 @@ protected:
       }
 
 public:
-   DLLLOCAL Var(const char* n_name) : loc(ParseLocation), val(QV_Node), name(n_name), parseTypeInfo(0), typeInfo(0), pub(false), finalized(false) {
+   DLLLOCAL Var(const char* n_name) : loc(ParseLocation), val(QV_Node), name(n_name), parseTypeInfo(0), typeInfo(0), pub(false), finalized(false), clone_slot(-1) {
    }
 
-   DLLLOCAL Var(const char* n_name, QoreParseTypeInfo *n_parseTypeInfo) : loc(ParseLocation), val(QV_Node), name(n_name), parseTypeInfo(n_parseTypeInfo), typeInfo(0), pub(false), finalized(false) {
+   DLLLOCAL Var(const char* n_name, QoreParseTypeInfo *n_parseTypeInfo) : loc(ParseLocation), val(QV_Node), name(n_name), parseTypeInfo(n_parseTypeInfo), typeInfo(0), pub(false), finalized(false), clone_slot(-1) {
    }
 
-   DLLLOCAL Var(const char* n_name, const QoreTypeInfo *n_typeInfo) : loc(ParseLocation), val(n_typeInfo), name(n_name), parseTypeInfo(0), typeInfo(n_typeInfo), pub(false), finalized(false) {
+   DLLLOCAL Var(const char* n_name, const QoreTypeInfo *n_typeInfo) : loc(ParseLocation), val(n_typeInfo), name(n_name), parseTypeInfo(0), typeInfo(n_typeInfo), pub(false), finalized(false), clone_slot(-1) {
    }
 
-   DLLLOCAL Var(Var* ref, bool ro = false) : loc(ref->loc), val(QV_Ref), name(ref->name), parseTypeInfo(0), typeInfo(ref->typeInfo), pub(false), finalized(false) {
+   DLLLOCAL Var(Var* ref, bool ro = false) : loc(ref->loc), val(QV_Ref), name(ref->name), parseTypeInfo(0), typeInfo(ref->typeInfo), pub(false), finalized(false), clone_slot(-1) {
       ref->ROreference();
       val.v.setPtr(ref, ro);
    }
 
+   // returns an independent copy of the variable for QoreProgram::clone(); the current value is shared by reference
+   // (container values are then copied on write); imported variables are copied as references to the same target
+   DLLLOCAL Var* copy() const {
+      return new Var(*this, true);
+   }
+
+   DLLLOCAL int getCloneSlot() const {
+      return clone_slot;
+   }
+
+   DLLLOCAL void setCloneSlot(int n_slot) {
+      assert(clone_slot == -1);
+      clone_slot = n_slot;
+   }
+
    DLLLOCAL const char* getName() const;
 
    DLLLOCAL int getLValue(LValueHelper& lvh, bool for_remove) const;
@@ -33,6 +33,21 @@
 
 #define QORE_QL_COMPRESSION_H
 
+#ifndef QORE_BZ2_WORK_FACTOR
+#define QORE_BZ2_WORK_FACTOR 30
+#endif
+
+#ifndef QORE_BZ2_VERBOSITY
+#define QORE_BZ2_VERBOSITY 0
+#endif
+
+#ifndef BZ2_DEFAULT_COMPRESSION
+#define BZ2_DEFAULT_COMPRESSION 9
+#endif
+
 DLLLOCAL void init_compression_functions(QoreNamespace& ns);
 
+// raises a ZLIB-ERROR exception for the given zlib error code
+DLLLOCAL void do_zlib_exception(int rc, const char* func, ExceptionSink* xsink);
+
 #endif
@@ -42,6 +42,7 @@ extern QoreHashNode* ENV;
 #include <errno.h>
 
 #include <map>
+#include <vector>
 
 typedef std::map<int, unsigned> ptid_map_t;
 
@@ -341,6 +342,9 @@ typedef std::map<std::string, AbstractQoreNode*> dmap_t;
 // map for pushed parse options
 typedef std::map<const char*, int64, ltstr> ppo_t;
 
+// table of global variables in the source program and the copies in a program clone, indexed by Var::getCloneSlot()
+typedef std::vector<std::pair<const Var*, Var*> > clone_var_vec_t;
+
 class AbstractQoreZoneInfo;
 
 class qore_program_private_base {
@@ -430,14 +434,36 @@ public:
    // public object that owns this private implementation
    QoreProgram* pgm;
 
-   DLLLOCAL qore_program_private_base(QoreProgram* n_pgm, int64 n_parse_options, QoreProgram* p_pgm = 0)
+   // for program clones: the program providing the code (always the original program, never another clone)
+   QoreProgram* clone_src;
+
+   // for program clones: the global variables in clone_src and the copies in this program; set up once when the
+   // clone is created so that global variables can be resolved at runtime without a lookup
+   clone_var_vec_t clone_vars;
+
+   // the number of clones executing the code of this program; the program's code and data are only cleared when
+   // there are no more clones (protected by plock)
+   unsigned clone_count;
+
+   // the number of global variables of this program that have been assigned a slot in the clone variable table
+   // (protected by plock)
+   int clone_slots;
+
+   DLLLOCAL qore_program_private_base(QoreProgram* n_pgm, int64 n_parse_options, QoreProgram* p_pgm = 0, bool clone = false)
       : thread_count(0), thread_waiting(0), parse_count(0), plock(&ma_recursive), parseSink(0), warnSink(0), pendingParseSink(0), RootNS(0), QoreNS(0),
         only_first_except(false), po_locked(false), po_allow_restrict(true), exec_class(false), base_object(false),
         requires_exception(false), tclear(0),
         exceptions_raised(0), ptid(0), pwo(n_parse_options), dom(0), pend_dom(0), thread_local_storage(0), twaiting(0),
-        thr_init(0), exec_class_rv(0), pgm(n_pgm) {
+        thr_init(0), exec_class_rv(0), pgm(n_pgm), clone_src(0), clone_count(0), clone_slots(0) {
       //printd(5, "qore_program_private_base::qore_program_private_base() this: %p pgm: %p po: "QLLD"\n", this, pgm, n_parse_options);
 
+      if (clone) {
+         assert(p_pgm);
+         // global variables and defines are copied from the source program
+         setClone(p_pgm);
+         return;
+      }
+
       if (p_pgm)
 	 setParent(p_pgm, n_parse_options);
       else {
@@ -445,18 +471,19 @@ public:
 	 newProgram();
       }
 
-      // initialize global vars
+      // initialize global vars; the process-wide values are shared by reference and are only copied if
+      // modified in the Program (lvalue updates copy shared containers before writing)
       Var *var = qore_root_ns_private::runtimeCreateVar(*RootNS, *QoreNS, "ARGV", listTypeInfo);
       if (var && ARGV)
-	 var->setInitial(ARGV->copy());
+	 var->setInitial(ARGV->listRefSelf());
 
       var = qore_root_ns_private::runtimeCreateVar(*RootNS, *QoreNS, "QORE_ARGV", listTypeInfo);
       if (var && QORE_ARGV)
-	 var->setInitial(QORE_ARGV->copy());
+	 var->setInitial(QORE_ARGV->listRefSelf());
 
       var = qore_root_ns_private::runtimeCreateVar(*RootNS, *QoreNS, "ENV", hashTypeInfo);
       if (var)
-         var->setInitial(ENV->copy());
+         var->setInitial(ENV->hashRefSelf());
       setDefines();
    }
 
@@ -471,6 +498,9 @@ public:
 protected:
    DLLLOCAL void setParent(QoreProgram* p_pgm, int64 n_parse_options);
 
+   // for program clones
+   DLLLOCAL void setClone(QoreProgram* src_pgm);
+
    // for independent programs (not inherited from another QoreProgram object)
    DLLLOCAL void newProgram();
 };
@@ -521,6 +551,11 @@ public:
       printd(5, "qore_program_private::qore_program_private() this: %p pgm: %p\n", this, pgm);
    }
 
+   // creates a program clone
+   DLLLOCAL qore_program_private(QoreProgram* n_pgm, const QoreProgram& src) : qore_program_private_base(n_pgm, src.priv->pwo.parse_options, const_cast<QoreProgram*>(&src), true) {
+      printd(5, "qore_program_private::qore_program_private() this: %p pgm: %p clone of %p\n", this, pgm, clone_src);
+   }
+
    DLLLOCAL ~qore_program_private() {
       printd(5, "qore_program_private::~qore_program_private() this: %p pgm: %p\n", this, pgm);
       assert(!parseSink);
@@ -1666,6 +1701,30 @@ public:
       pgm->priv->finalizeThreadData(td, cl);
    }
 
+   // returns the program whose code is executed by the given program clone, or 0 if the program is not a clone
+   DLLLOCAL static QoreProgram* getCloneSource(const QoreProgram* pgm) {
+      return pgm ? pgm->priv->clone_src : 0;
+   }
+
+   // returns the global variable to use at runtime; variables of programs that have never been cloned are used
+   // directly, otherwise when the current program is a clone, global variables referenced by the shared code of the
+   // source program are resolved to the clone's own copies
+   DLLLOCAL static Var* runtimeGetGlobalVar(Var* v) {
+      int slot = v->getCloneSlot();
+      if (slot < 0)
+         return v;
+
+      QoreProgram* pgm = getProgram();
+      if (!pgm)
+         return v;
+
+      // the slot is read once; the table of the current program is only written when the clone is created, before
+      // the clone can execute any code, so it can be read without a lock; if the source program has been cloned in
+      // the meantime, the source has no table and the variable is used directly
+      const clone_var_vec_t& cv = pgm->priv->clone_vars;
+      return (unsigned)slot < cv.size() && cv[slot].first == v ? cv[slot].second : v;
+   }
+
    DLLLOCAL static int endThread(QoreProgram* pgm, ThreadProgramData* td, ExceptionSink* xsink) {
       return pgm->priv->endThread(td, xsink);
    }
@@ -43,17 +43,29 @@
 #include <stdio.h>
 #include <errno.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
 
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 #include <string>
 
 #ifndef DEFAULT_FILE_BUFSIZE
 #define DEFAULT_FILE_BUFSIZE 16384
 #endif
 
+// maximum size of the write-behind buffer
+#define QORE_FILE_MAX_WRITE_BUFSIZE (16 * 1024 * 1024)
+
 struct qore_qf_private {
    int fd;
    bool is_open;
@@ -62,15 +74,33 @@ struct qore_qf_private {
    std::string filename;
    mutable QoreThreadLock m;
    Queue* cb_queue;
+   // read-ahead buffer for regular files; allocated with the first buffered read
+   mutable char* rbuf;
+   // number of bytes in the read-ahead buffer and the offset of the next byte to be returned
+   mutable qore_size_t rbuf_len, rbuf_pos;
+   // true if reads are buffered (only for regular files)
+   bool rbuf_ok;
+   // true if rbuf is a read-only mapping of the entire file and rbuf_len is the size of the mapping
+   bool mapped;
+   // write-behind buffer; allocated when a write buffer size is set
+   mutable char* wbuf;
+   // number of bytes waiting in the write buffer
+   mutable qore_size_t wbuf_len;
+   // size of the write buffer; 0 = writes are not buffered
+   qore_size_t wbuf_size;
 
    DLLLOCAL qore_qf_private(const QoreEncoding* cs) : is_open(false),
 						      special_file(false),
 						      charset(cs), 
-						      cb_queue(0) {
+						      cb_queue(0),
+						      rbuf(0), rbuf_len(0), rbuf_pos(0), rbuf_ok(false), mapped(false),
+						      wbuf(0), wbuf_len(0), wbuf_size(0) {
    }
 
    DLLLOCAL ~qore_qf_private() {
       close_intern();
+      free(rbuf);
+      free(wbuf);
 
       // must be dereferenced and removed before deleting
       assert(!cb_queue);
@@ -78,9 +108,23 @@ struct qore_qf_private {
 
    DLLLOCAL int close_intern() {
       filename.clear();
+#ifdef HAVE_SYS_MMAN_H
+      if (mapped) {
+         if (rbuf)
+            munmap(rbuf, rbuf_len);
+         rbuf = 0;
+         mapped = false;
+      }
+#endif
+      discardReadBuffer();
+      rbuf_ok = false;
 
       int rc;
       if (is_open) {
+	 // write out any buffered data; unwritten data is discarded if this fails
+	 int frc = flushWriteBuffer();
+	 wbuf_len = 0;
+
 	 if (special_file)
 	    rc = -1;
 	 else {	    
@@ -88,6 +132,8 @@ struct qore_qf_private {
 	    is_open = false;
 	    do_close_event_unlocked();
 	 }
+	 if (frc)
+	    rc = -1;
       }
       else
 	 rc = 0;
@@ -118,7 +164,263 @@ struct qore_qf_private {
       if (cs)
 	 charset = cs;
       is_open = true;
+
+      // only reads from regular files are buffered, so that the file position can always be restored
+      struct stat sbuf;
+      rbuf_ok = !fstat(fd, &sbuf) && S_ISREG(sbuf.st_mode);
+      return 0;
+   }
+
+   // returns the number of bytes in the read-ahead buffer that have not been read yet
+   DLLLOCAL qore_size_t buffered() const {
+      return rbuf_len - rbuf_pos;
+   }
+
+   // discards the read-ahead buffer without changing the file position
+   DLLLOCAL void discardReadBuffer() const {
+      rbuf_len = rbuf_pos = 0;
+   }
+
+   // discards the read-ahead buffer and moves the file position back to the position of the next byte to be read
+   /** must be called before any operation that uses the file descriptor's position directly
+    */
+   DLLLOCAL void syncReadBuffer() const {
+      if (mapped) {
+         lseek(fd, rbuf_pos, SEEK_SET);
+         return;
+      }
+      if (rbuf_pos < rbuf_len)
+         lseek(fd, -(off_t)(rbuf_len - rbuf_pos), SEEK_CUR);
+      discardReadBuffer();
+   }
+
+   // unlocked, assumes file is open; writes to the file without using the write buffer
+   DLLLOCAL qore_offset_t writeRaw(const void* buf, qore_size_t len) const {
+      qore_offset_t rc;
+      while (true) {
+	 rc = ::write(fd, buf, len);
+	 // try again if we are interrupted by a signal
+	 if (rc >= 0 || errno != EINTR)
+	    break;
+      }
+      return rc;
+   }
+
+   // unlocked, assumes file is open; writes all data in the write buffer to the file
+   /** returns 0 for success, -1 for error (errno is set and the data not yet written stays in the buffer)
+    */
+   DLLLOCAL int flushWriteBuffer() const {
+      qore_size_t done = 0;
+      while (done < wbuf_len) {
+         qore_offset_t rc = writeRaw(wbuf + done, wbuf_len - done);
+         if (rc < 0) {
+            if (done) {
+               wbuf_len -= done;
+               memmove(wbuf, wbuf + done, wbuf_len);
+            }
+            return -1;
+         }
+         done += rc;
+      }
+      wbuf_len = 0;
+      return 0;
+   }
+
+   // unlocked, assumes file is open; reads from the file without using the read-ahead buffer
+   DLLLOCAL qore_offset_t readRaw(void* buf, qore_size_t bs) const {
+      // buffered writes must reach the file before it can be read
+      if (wbuf_len && flushWriteBuffer())
+         return -1;
+
+      qore_offset_t rc;
+      while (true) {
+	 rc = ::read(fd, buf, bs);
+	 // try again if we were interrupted by a signal
+	 if (rc >= 0 || errno != EINTR)
+	    break;
+      }
+      return rc;
+   }
+
+   // fills the empty read-ahead buffer; returns the number of bytes read, 0 for EOF, or -1 for errors
+   DLLLOCAL qore_offset_t fillReadBuffer() const {
+      assert(rbuf_ok);
+      assert(rbuf_pos == rbuf_len);
+      // a mapped file is entirely in the buffer
+      if (mapped)
+         return 0;
+      discardReadBuffer();
+      if (!rbuf) {
+         rbuf = (char*)malloc(DEFAULT_FILE_BUFSIZE);
+         if (!rbuf)
+            return -1;
+      }
+      qore_offset_t rc = readRaw(rbuf, DEFAULT_FILE_BUFSIZE);
+      if (rc > 0)
+         rbuf_len = rc;
+      return rc;
+   }
+
+   // reads through the read-ahead buffer until bs bytes have been read or EOF is reached; large reads bypass the buffer
+   DLLLOCAL qore_offset_t readBuffered(char* buf, qore_size_t bs) const {
+      qore_size_t br = 0;
+      while (br < bs) {
+         if (rbuf_pos == rbuf_len) {
+            bool direct = !mapped && bs - br >= DEFAULT_FILE_BUFSIZE;
+            qore_offset_t rc = direct ? readRaw(buf + br, bs - br) : fillReadBuffer();
+            if (rc <= 0)
+               return br ? br : rc;
+            if (direct) {
+               br += rc;
+               continue;
+            }
+         }
+         qore_size_t n = bs - br;
+         if (n > rbuf_len - rbuf_pos)
+            n = rbuf_len - rbuf_pos;
+         memcpy(buf + br, rbuf + rbuf_pos, n);
+         rbuf_pos += n;
+         br += n;
+      }
+      return br;
+   }
+
+   // moves the read position back by len bytes
+   DLLLOCAL void unread(qore_size_t len) const {
+      if (rbuf_pos >= len) {
+         rbuf_pos -= len;
+         return;
+      }
+      syncReadBuffer();
+      lseek(fd, -(off_t)len, SEEK_CUR);
+   }
+
+   // sets the read position; unlocked, assumes file is open
+   DLLLOCAL qore_size_t setPosIntern(qore_size_t pos) {
+      if (wbuf_len && flushWriteBuffer())
+         return -1;
+      if (mapped) {
+         rbuf_pos = pos > rbuf_len ? rbuf_len : pos;
+         return rbuf_pos;
+      }
+      discardReadBuffer();
+      return lseek(fd, pos, SEEK_SET);
+   }
+
+   // maps the file into memory for reading; the mapping replaces the read-ahead buffer
+   DLLLOCAL int map(ExceptionSink* xsink) {
+      AutoLocker al(m);
+
+      if (!is_open) {
+         xsink->raiseException("FILE-MAP-ERROR", "file has not been opened");
+         return -1;
+      }
+
+      if (mapped)
+         return 0;
+
+#ifdef HAVE_SYS_MMAN_H
+      if (!rbuf_ok) {
+         xsink->raiseException("FILE-MAP-ERROR", "'%s' is not a regular file and cannot be mapped into memory", filename.c_str());
+         return -1;
+      }
+
+      // writes through the descriptor would not be visible in the buffered position logic
+      if ((fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDONLY) {
+         xsink->raiseException("FILE-MAP-ERROR", "'%s' must be opened read-only to be mapped into memory", filename.c_str());
+         return -1;
+      }
+
+      struct stat sbuf;
+      if (fstat(fd, &sbuf)) {
+         xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "cannot stat '%s'", filename.c_str());
+         return -1;
+      }
+
+      qore_size_t size = sbuf.st_size;
+      qore_size_t pos = lseek(fd, 0, SEEK_CUR) - buffered();
+
+      // an empty file has no mapping; reads return EOF immediately
+      void* p = 0;
+      if (size) {
+         p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+         if (p == MAP_FAILED) {
+            xsink->raiseErrnoException("FILE-MAP-ERROR", errno, "cannot map '%s' into memory", filename.c_str());
+            return -1;
+         }
+#ifdef MADV_SEQUENTIAL
+         madvise(p, size, MADV_SEQUENTIAL);
+#endif
+      }
+
+      free(rbuf);
+      rbuf = (char*)p;
+      rbuf_len = size;
+      rbuf_pos = pos > size ? size : pos;
+      mapped = true;
       return 0;
+#else
+      xsink->raiseException("MISSING-FEATURE-ERROR", "memory-mapped files are not supported on this platform");
+      return -1;
+#endif
+   }
+
+   // writes out any buffered data; returns 0 for success, -1 for exception
+   DLLLOCAL int flush(ExceptionSink* xsink) const {
+      AutoLocker al(m);
+
+      if (check_write_open(xsink))
+         return -1;
+
+      return flushIntern(xsink);
+   }
+
+   // unlocked, assumes file is open; returns 0 for success, -1 for exception
+   DLLLOCAL int flushIntern(ExceptionSink* xsink) const {
+      if (wbuf_len && flushWriteBuffer()) {
+         xsink->raiseErrnoException("FILE-WRITE-ERROR", errno, "failed writing "QSD" buffered byte%s to File", wbuf_len, wbuf_len == 1 ? "" : "s");
+         return -1;
+      }
+      return 0;
+   }
+
+   // sets the size of the write-behind buffer; 0 disables write buffering
+   DLLLOCAL int setWriteBufferSize(int64 size, ExceptionSink* xsink) {
+      if (size < 0 || size > QORE_FILE_MAX_WRITE_BUFSIZE) {
+         xsink->raiseException("FILE-WRITE-BUFFER-ERROR", "invalid write buffer size "QLLD"; the size must be between 0 and %d bytes", size, QORE_FILE_MAX_WRITE_BUFSIZE);
+         return -1;
+      }
+
+      AutoLocker al(m);
+
+      // write out data buffered with the old size first
+      if (is_open && flushIntern(xsink))
+         return -1;
+
+      if (!size) {
+         free(wbuf);
+         wbuf = 0;
+      }
+      else if ((qore_size_t)size != wbuf_size) {
+         char* nbuf = (char*)realloc(wbuf, size);
+         if (!nbuf) {
+            xsink->outOfMemory();
+            return -1;
+         }
+         wbuf = nbuf;
+      }
+      wbuf_size = size;
+      return 0;
+   }
+
+   DLLLOCAL int64 getWriteBufferSize() const {
+      AutoLocker al(m);
+      return wbuf_size;
+   }
+
+   DLLLOCAL bool isMapped() const {
+      AutoLocker al(m);
+      return mapped;
    }
 
    DLLLOCAL int open(const char* fn, int flags, int mode, const QoreEncoding* cs) {
@@ -165,19 +467,37 @@ struct qore_qf_private {
 
       if (check_read_open(xsink))
 	 return false;
+
+      if (buffered())
+         return true;
       
       return isDataAvailableIntern(timeout_ms);
    }
 
    // assumes lock is held and file is open
    DLLLOCAL bool isDataAvailableIntern(int timeout_ms) const {
+      int rc;
+#ifdef HAVE_POLL_H
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      while (true) {
+	 rc = poll(&pfd, 1, timeout_ms);
+	 // retry if we were interrupted by a signal
+	 if (rc >= 0 || errno != EINTR)
+	    break;
+      }
+      if (rc > 0 && (pfd.revents & POLLNVAL))
+         return false;
+#else
       fd_set sfs;
       
       FD_ZERO(&sfs);
       FD_SET(fd, &sfs);
 
       struct timeval tv;
-      int rc;
       while (true) {
 	 tv.tv_sec  = timeout_ms / 1000;
 	 tv.tv_usec = (timeout_ms % 1000) * 1000;
@@ -187,6 +507,7 @@ struct qore_qf_private {
 	 if (rc >= 0 || errno != EINTR)
 	    break;
       }
+#endif
       return rc;
    }
 
@@ -212,13 +533,7 @@ struct qore_qf_private {
 
    // unlocked, assumes file is open
    DLLLOCAL qore_size_t read(void *buf, qore_size_t bs) const {
-      qore_offset_t rc;
-      while (true) {
-	 rc = ::read(fd, buf, bs);
-	 // try again if we were interrupted by a signal
-	 if (rc >= 0 || errno != EINTR)
-	    break;
-      }
+      qore_offset_t rc = rbuf_ok ? readBuffered((char*)buf, bs) : readRaw(buf, bs);
 
       if (rc > 0)
 	 do_read_event_unlocked(rc, rc, bs);
@@ -228,14 +543,25 @@ struct qore_qf_private {
 
    // unlocked, assumes file is open
    DLLLOCAL qore_size_t write(const void* buf, qore_size_t len, ExceptionSink* xsink = 0) const {
-      qore_offset_t rc;
-      while (true) {
-	 rc = ::write(fd, buf, len);
-	 // try again if we are interrupted by a signal
-	 if (rc >= 0 || errno != EINTR)
-	    break;
+      syncReadBuffer();
+
+      if (wbuf_size) {
+         // make room in the buffer, or write out the buffered data before a write that is too large to be buffered
+         if (wbuf_len + len > wbuf_size && flushWriteBuffer()) {
+            if (xsink)
+               xsink->raiseErrnoException("FILE-WRITE-ERROR", errno, "failed writing "QSD" buffered byte%s to File", wbuf_len, wbuf_len == 1 ? "" : "s");
+            return -1;
+         }
+         if (len < wbuf_size) {
+            memcpy(wbuf + wbuf_len, buf, len);
+            wbuf_len += len;
+            do_write_event_unlocked(len, len, len);
+            return len;
+         }
       }
 
+      qore_offset_t rc = writeRaw(buf, len);
+
       if (rc > 0)
 	 do_write_event_unlocked(rc, rc, len);
       else if (xsink && rc < 0)
@@ -246,6 +572,13 @@ struct qore_qf_private {
 
    // private function, unlocked
    DLLLOCAL int readChar() const {
+      if (rbuf_ok) {
+         if (rbuf_pos == rbuf_len && fillReadBuffer() <= 0)
+            return -1;
+         do_read_event_unlocked(1, 1, 1);
+         return (unsigned char)rbuf[rbuf_pos++];
+      }
+
       unsigned char ch = 0;
       if (read(&ch, 1) != 1)
 	 return -1;
@@ -279,6 +612,21 @@ struct qore_qf_private {
    }
 
    DLLLOCAL char* readBlock(qore_offset_t &size, int timeout_ms, ExceptionSink* xsink) {
+      // copy directly from the mapping; no reads and no intermediate buffer are needed
+      if (mapped) {
+         qore_size_t n = buffered();
+         if (size > 0 && (qore_size_t)size < n)
+            n = size;
+         if (!n)
+            return 0;
+         char* bbuf = (char*)malloc(sizeof(char) * (n + 1));
+         memcpy(bbuf, rbuf + rbuf_pos, n);
+         rbuf_pos += n;
+         do_read_event_unlocked(n, n, size);
+         size = n;
+         return bbuf;
+      }
+
       qore_size_t bs = size > 0 && size < DEFAULT_FILE_BUFSIZE ? size : DEFAULT_FILE_BUFSIZE;
       qore_size_t br = 0;
       char* buf = (char* )malloc(sizeof(char) * bs);
@@ -286,19 +634,21 @@ struct qore_qf_private {
 
       while (true) {
 	 // wait for data
-	 if (timeout_ms >= 0 && !isDataAvailableIntern(timeout_ms)) {
+	 if (timeout_ms >= 0 && !buffered() && !isDataAvailableIntern(timeout_ms)) {
 	    xsink->raiseException("FILE-READ-TIMEOUT", "timeout limit exceeded (%d ms) reading file block", timeout_ms);
 	    br = 0;
 	    break;
 	 }
 
 	 qore_offset_t rc;
-	 while (true) {
-	    rc = ::read(fd, buf, bs);
-	    // try again if we were interrupted by a signal
-	    if (rc >= 0 || errno != EINTR)
-	       break;
+	 // return any data in the read-ahead buffer first
+	 if (buffered()) {
+	    rc = bs < buffered() ? bs : buffered();
+	    memcpy(buf, rbuf + rbuf_pos, rc);
+	    rbuf_pos += rc;
 	 }
+	 else
+	    rc = readRaw(buf, bs);
 	 //printd(5, "readBlock(fd: %d, buf: %p, bs: %d) rc: %d\n", fd, buf, bs, rc);
 	 if (rc <= 0)
 	    break;
@@ -349,6 +699,9 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
+      if (rbuf_ok)
+         return readLineBuffered(str, incl_eol);
+
       bool tty = (bool)isatty(fd);
 
       int ch, rc = -1;
@@ -388,6 +741,49 @@ struct qore_qf_private {
       return rc;
    }
 
+   // reads a line from the read-ahead buffer; lines are terminated by '\n', '\r', or '\r\n'
+   DLLLOCAL int readLineBuffered(QoreString& str, bool incl_eol) {
+      int rc = -1;
+
+      while (rbuf_pos < rbuf_len || fillReadBuffer() > 0) {
+         rc = 0;
+         const char* start = rbuf + rbuf_pos;
+         qore_size_t len = rbuf_len - rbuf_pos;
+         // find the first '\n' and then look for an earlier '\r'
+         const char* p = (const char*)memchr(start, '\n', len);
+         const char* cr = (const char*)memchr(start, '\r', p ? p - start : len);
+         if (cr)
+            p = cr;
+
+         if (!p) {
+            str.concat(start, len);
+            rbuf_pos = rbuf_len;
+            do_read_event_unlocked(len, str.size(), -1);
+            continue;
+         }
+
+         qore_size_t n = p - start + 1;
+         str.concat(start, incl_eol ? n : n - 1);
+         rbuf_pos += n;
+
+         if (*p == '\r') {
+            // see if the next byte is '\n'
+            if (rbuf_pos < rbuf_len || fillReadBuffer() > 0) {
+               if (rbuf[rbuf_pos] == '\n') {
+                  ++rbuf_pos;
+                  ++n;
+                  if (incl_eol)
+                     str.concat('\n');
+               }
+            }
+         }
+         do_read_event_unlocked(n, str.size(), -1);
+         break;
+      }
+
+      return rc;
+   }
+
    DLLLOCAL int readUntil(char byte, QoreString& str, bool incl_byte = true) {
       str.clear();
 
@@ -396,6 +792,28 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
+      if (rbuf_ok) {
+         int rc = -1;
+         while (rbuf_pos < rbuf_len || fillReadBuffer() > 0) {
+            rc = 0;
+            const char* start = rbuf + rbuf_pos;
+            qore_size_t len = rbuf_len - rbuf_pos;
+            const char* p = (const char*)memchr(start, byte, len);
+            if (!p) {
+               str.concat(start, len);
+               rbuf_pos = rbuf_len;
+               do_read_event_unlocked(len, str.size(), -1);
+               continue;
+            }
+            qore_size_t n = p - start + 1;
+            str.concat(start, incl_byte ? n : n - 1);
+            rbuf_pos += n;
+            do_read_event_unlocked(n, str.size(), -1);
+            break;
+         }
+         return rc;
+      }
+
       int ch, rc = -1;
 
       while ((ch = readChar()) >= 0) {
@@ -434,7 +852,7 @@ struct qore_qf_private {
       if (!is_open)
          return -2;
 
-      bool tty = (bool)isatty(fd);
+      bool tty = !rbuf_ok && isatty(fd);
 
       int ch, rc = -1;
 
@@ -466,7 +884,7 @@ struct qore_qf_private {
                   }
                   else {
                      // reset file to previous byte position
-                     lseek(fd, -len, SEEK_CUR);
+                     unread(len);
                   }
                }
             }
@@ -650,7 +1068,10 @@ struct qore_qf_private {
       if (!is_open)
          return -1;
 
-      return lseek(fd, 0, SEEK_CUR);
+      if (mapped)
+         return rbuf_pos;
+
+      return lseek(fd, 0, SEEK_CUR) - buffered() + wbuf_len;
    }
 
    DLLLOCAL void setEventQueue(Queue* cbq, ExceptionSink* xsink) {
@@ -748,7 +1169,8 @@ struct qore_qf_private {
    DLLLOCAL QoreListNode* stat(ExceptionSink* xsink) const {
       AutoLocker al(m);
 
-      if (check_read_open(xsink))
+      // buffered writes must be included in the file size
+      if (check_read_open(xsink) || flushIntern(xsink))
 	 return 0;
    
       struct stat sbuf;
@@ -763,7 +1185,8 @@ struct qore_qf_private {
    DLLLOCAL QoreHashNode* hstat(ExceptionSink* xsink) const {
       AutoLocker al(m);
 
-      if (check_read_open(xsink))
+      // buffered writes must be included in the file size
+      if (check_read_open(xsink) || flushIntern(xsink))
 	 return 0;
    
       struct stat sbuf;
@@ -50,14 +50,60 @@
 #include <sys/select.h>
 #endif
 
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
+#ifndef _Q_WINDOWS
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
 #ifndef DEFAULT_SOCKET_BUFSIZE
 #define DEFAULT_SOCKET_BUFSIZE 4096
 #endif
 
+// maximum read buffer size reached by adapting to the amount of data received
+#ifndef QORE_SOCKET_MAX_ADAPTIVE_BUFSIZE
+#define QORE_SOCKET_MAX_ADAPTIVE_BUFSIZE 65536
+#endif
+
+// maximum read buffer size that can be set explicitly
+#define QORE_SOCKET_MAX_READ_BUFSIZE (16 * 1024 * 1024)
+
+// number of consecutive reads using less than a quarter of the read buffer before it is shrunk
+#define QORE_SOCKET_SHRINK_READS 16
+
 #ifndef QORE_MAX_HEADER_SIZE
 #define QORE_MAX_HEADER_SIZE 16384
 #endif
 
+// maximum amount of data copied into a single buffer for a gathered send on an SSL connection
+#ifndef QORE_SSL_GATHER_SIZE
+#define QORE_SSL_GATHER_SIZE 16384
+#endif
+
+// buffer size for sending file data that cannot be sent with sendfile()
+#ifndef QORE_SENDFILE_BUFSIZE
+#define QORE_SENDFILE_BUFSIZE 65536
+#endif
+
+// maximum amount of file data sent with a single sendfile() call
+#define QORE_SENDFILE_MAX (1024 * 1024)
+
+// maximum number of buffers in a gathered send
+#define QORE_SOCKET_MAX_IOV 4
+
+// send flag to tell the kernel that more data will follow immediately
+#ifdef MSG_MORE
+#define QORE_MSG_MORE MSG_MORE
+#else
+#define QORE_MSG_MORE 0
+#endif
+
 #define CHF_HTTP11  (1 << 0)
 #define CHF_PROCESS (1 << 1)
 #define CHF_REQUEST (1 << 2)
@@ -94,6 +140,12 @@ DLLLOCAL int check_windows_rc(int rc);
 #define QORE_SOCKET_ERROR -1
 #endif
 
+// a buffer to be sent as part of a gathered send
+struct qore_send_buf {
+   const char* buf;
+   qore_size_t size;
+};
+
 struct qore_socketsource_private {
    QoreStringNode* address;
    QoreStringNode* hostname;
@@ -203,8 +255,12 @@ struct qore_socket_private {
    SSLSocketHelper* ssl;
    Queue* cb_queue,
       * warn_queue;
-   // socket buffer for buffered reads
-   char rbuf[DEFAULT_SOCKET_BUFSIZE];
+   // socket buffer for buffered reads; allocated with the first read
+   char* rbuf;
+   // allocated size of rbuf, size to use for the next read, and fixed size set by the user (0 = adaptive)
+   qore_size_t rbuf_alloc, rbuf_size, rbuf_fixed;
+   // number of consecutive small reads for shrinking an adaptive buffer
+   int rbuf_small;
    // current buffer size
    size_t buflen, bufoffset;
    int64 tl_warning_us;     // timeout threshold for network action warning in microseconds
@@ -220,7 +276,8 @@ struct qore_socket_private {
 
    DLLLOCAL qore_socket_private(int n_sock = QORE_INVALID_SOCKET, int n_sfamily = AF_UNSPEC, int n_stype = SOCK_STREAM, int n_prot = 0, const QoreEncoding* n_enc = QCS_DEFAULT) :
       sock(n_sock), sfamily(n_sfamily), port(-1), stype(n_stype), sprot(n_prot), enc(n_enc),
-      ssl(0), cb_queue(0), warn_queue(0), buflen(0), bufoffset(0), tl_warning_us(0), tp_warning_bs(0),
+      ssl(0), cb_queue(0), warn_queue(0), rbuf(0), rbuf_alloc(0), rbuf_size(DEFAULT_SOCKET_BUFSIZE), rbuf_fixed(0), rbuf_small(0),
+      buflen(0), bufoffset(0), tl_warning_us(0), tp_warning_bs(0),
       tp_bytes_sent(0), tp_bytes_recv(0), tp_us_sent(0), tp_us_recv(0), tp_us_min(0),
       callback_arg(0), del(false), in_op(false), http_exp_chunked_body(false) {
       //sendTimeout = recvTimeout = -1
@@ -228,6 +285,7 @@ struct qore_socket_private {
 
    DLLLOCAL ~qore_socket_private() {
       close_internal();
+      free(rbuf);
 
       // must be dereferenced and removed before deleting
       assert(!cb_queue);
@@ -266,6 +324,11 @@ struct qore_socket_private {
 	 buflen = 0;
       if (bufoffset)
 	 bufoffset = 0;
+      // an adaptive read buffer starts again with the default size for the next connection
+      if (!rbuf_fixed && rbuf_size != DEFAULT_SOCKET_BUFSIZE) {
+         rbuf_size = DEFAULT_SOCKET_BUFSIZE;
+         rbuf_small = 0;
+      }
       if (del)
 	 del = false;
       if (port != -1)
@@ -381,7 +444,7 @@ struct qore_socket_private {
 	 while (hi.next()) {
 	    const AbstractQoreNode* v = hi.getValue();
 	    const char* key = hi.getKey();
-	    if (addsize && !strcasecmp(key, "transfer-encoding"))
+	    if (addsize && (!strcasecmp(key, "transfer-encoding") || !strcasecmp(key, "content-length")))
 	       addsize = false;
 	    if (v && v->getType() == NT_LIST) {
 	       ConstListIterator li(reinterpret_cast<const QoreListNode* >(v));
@@ -784,6 +847,9 @@ struct qore_socket_private {
    }
 
    // socket must be open!
+   /* uses poll() where available, which (unlike select()) does not depend on the number of the descriptor and
+      works with descriptors >= FD_SETSIZE
+   */
    DLLLOCAL int select(int timeout_ms, bool read, const char* mname, ExceptionSink* xsink) {
       if (sock == QORE_INVALID_SOCKET) {
 	 if (xsink)
@@ -791,13 +857,30 @@ struct qore_socket_private {
 	 return -1;
       }
 
+      int rc;
+#ifdef HAVE_POLL_H
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = read ? POLLIN : POLLOUT;
+      pfd.revents = 0;
+
+      while (true) {
+	 rc = ::poll(&pfd, 1, timeout_ms);
+	 if (rc != QORE_SOCKET_ERROR || sock_get_error() != EINTR)
+	    break;
+      }
+      // an invalid descriptor is reported in revents instead of as an error
+      if (rc > 0 && (pfd.revents & POLLNVAL)) {
+         errno = EBADF;
+         rc = QORE_SOCKET_ERROR;
+      }
+#else
       fd_set sfs;
 
       FD_ZERO(&sfs);
       FD_SET(sock, &sfs);
 
       struct timeval tv;
-      int rc;
       while (true) {
 	 tv.tv_sec  = timeout_ms / 1000;
 	 tv.tv_usec = (timeout_ms % 1000) * 1000;
@@ -806,6 +889,7 @@ struct qore_socket_private {
 	 if (rc != QORE_SOCKET_ERROR || sock_get_error() != EINTR)
 	    break;
       }
+#endif
       if (rc == QORE_SOCKET_ERROR) {
          rc = 0;
          switch (sock_get_error()) {
@@ -818,7 +902,11 @@ struct qore_socket_private {
                break;
 #endif
             default:
+#ifdef HAVE_POLL_H
+               qore_socket_error(xsink, "SOCKET-SELECT-ERROR", "poll() returned an error");
+#else
                qore_socket_error(xsink, "SOCKET-SELECT-ERROR", "select() returned an error");
+#endif
                break;
          }
       }
@@ -830,8 +918,13 @@ struct qore_socket_private {
       return select(timeout_ms, true, mname, xsink);
    }
 
+   // returns true if data has already been read from the socket (into the read buffer or the SSL object) and can be returned without waiting
+   DLLLOCAL bool isDataBuffered() const {
+      return buflen || (ssl && ssl->pending());
+   }
+
    DLLLOCAL bool isDataAvailable(int timeout_ms, const char* mname, ExceptionSink* xsink) {
-      if (buflen)
+      if (isDataBuffered())
 	 return true;
       return isSocketDataAvailable(timeout_ms, mname, xsink);
    }
@@ -1336,30 +1429,11 @@ struct qore_socket_private {
 #endif
    }
 
-   // buffered reads for high performance
-   DLLLOCAL qore_offset_t brecv(ExceptionSink* xsink, const char* meth, char*& buf, qore_size_t bs, int flags, int timeout, bool do_event = true) {
+   // reads data from the socket into the given buffer, waiting for data if a timeout is given; closes the socket if the remote end has closed the connection
+   DLLLOCAL qore_offset_t recvIntern(ExceptionSink* xsink, const char* meth, char* buf, qore_size_t bs, int flags, int timeout) {
       // must be checked if open/connected before this function is called
       assert(sock != QORE_INVALID_SOCKET);
-      assert(meth);
-
-      // always returned buffered data first
-      if (buflen) {
-	 buf = rbuf + bufoffset;
-	 if (buflen <= bs) {
-	    bs = buflen;
-	    buflen = 0;
-	    bufoffset = 0;
-	 }
-	 else {
-	    buflen -= bs;
-	    bufoffset += bs;
-	 }
-	 return (qore_offset_t)bs;
-      }
-
-      // real socket reads are only done when the buffer is empty
-
-      //printd(5, "qore_socket_private::brecv(buf=%p, bs=%d, flags=%d, timeout=%d, do_event=%d) this=%p ssl=%d\n", buf, (int)bs, flags, timeout, (int)do_event, this, ssl);
+      assert(!buflen);
 
       qore_offset_t rc;
       if (!ssl) {
@@ -1377,7 +1451,7 @@ struct qore_socket_private {
 #ifdef DEBUG
 	    errno = 0;
 #endif
-	    rc = ::recv(sock, rbuf, DEFAULT_SOCKET_BUFSIZE, flags);
+	    rc = ::recv(sock, buf, bs, flags);
 	    if (rc == QORE_SOCKET_ERROR) {
 	       sock_get_error();
 	       if (errno == EINTR)
@@ -1394,17 +1468,93 @@ struct qore_socket_private {
 		  qore_socket_error(xsink, "SOCKET-RECV-ERROR", "error in recv()", meth);
 	       break;
 	    }
-	    //printd(5, "qore_socket_private::brecv(%d, %p, %ld, %d) rc=%ld errno=%d\n", sock, buf, bs, flags, rc, errno);
+	    //printd(5, "qore_socket_private::recvIntern(%d, %p, %ld, %d) rc=%ld errno=%d\n", sock, buf, bs, flags, rc, errno);
 	    // try again if we were interrupted by a signal
 	    if (rc >= 0)
 	       break;
 	 }
       }
       else
-	 rc = ssl->read(meth, rbuf, DEFAULT_SOCKET_BUFSIZE, timeout, xsink);
+	 rc = ssl->read(meth, buf, bs, timeout, xsink);
+
+      if (!rc)
+         close();
+
+      return rc;
+   }
+
+   // makes sure that the read buffer is allocated with the current buffer size; the buffer must be empty
+   DLLLOCAL int checkReadBuffer(ExceptionSink* xsink) {
+      assert(!buflen);
+      if (rbuf_alloc == rbuf_size)
+         return 0;
+      free(rbuf);
+      rbuf = (char*)malloc(rbuf_size);
+      if (!rbuf) {
+         rbuf_alloc = 0;
+         if (xsink)
+            xsink->outOfMemory();
+         return -1;
+      }
+      rbuf_alloc = rbuf_size;
+      bufoffset = 0;
+      return 0;
+   }
+
+   // adapts the size of the read buffer for the next read to the amount of data received by the last read
+   DLLLOCAL void adaptReadBuffer(qore_size_t rc) {
+      if (rbuf_fixed)
+         return;
+      if (rc == rbuf_alloc) {
+         // the last read filled the buffer, so more data is probably waiting
+         if (rbuf_size < QORE_SOCKET_MAX_ADAPTIVE_BUFSIZE)
+            rbuf_size *= 2;
+         rbuf_small = 0;
+      }
+      else if (rbuf_size > DEFAULT_SOCKET_BUFSIZE && rc < (rbuf_alloc / 4)) {
+         if (++rbuf_small == QORE_SOCKET_SHRINK_READS) {
+            rbuf_size /= 2;
+            rbuf_small = 0;
+         }
+      }
+      else
+         rbuf_small = 0;
+   }
+
+   // buffered reads for high performance
+   DLLLOCAL qore_offset_t brecv(ExceptionSink* xsink, const char* meth, char*& buf, qore_size_t bs, int flags, int timeout, bool do_event = true) {
+      // must be checked if open/connected before this function is called
+      assert(sock != QORE_INVALID_SOCKET);
+      assert(meth);
+
+      // always returned buffered data first
+      if (buflen) {
+	 buf = rbuf + bufoffset;
+	 if (buflen <= bs) {
+	    bs = buflen;
+	    buflen = 0;
+	    bufoffset = 0;
+	 }
+	 else {
+	    buflen -= bs;
+	    bufoffset += bs;
+	 }
+	 return (qore_offset_t)bs;
+      }
+
+      // real socket reads are only done when the buffer is empty
+
+      //printd(5, "qore_socket_private::brecv(buf=%p, bs=%d, flags=%d, timeout=%d, do_event=%d) this=%p ssl=%d\n", buf, (int)bs, flags, timeout, (int)do_event, this, ssl);
+
+      if (checkReadBuffer(xsink))
+         return -1;
+
+      qore_offset_t rc = recvIntern(xsink, meth, rbuf, rbuf_alloc, flags, timeout);
 
       //printd(5, "qore_socket_private::brecv(%d, %p, %ld, %d) rc: %ld errno: %d\n", sock, buf, bs, flags, rc, errno);
       if (rc > 0) {
+	 adaptReadBuffer(rc);
+
 	 buf = rbuf;
 	 assert(!buflen);
 	 assert(!bufoffset);
@@ -1418,18 +1568,78 @@ struct qore_socket_private {
 	 if (do_event)
 	    do_read_event(rc, rc);
       }
-      else {
 #ifdef DEBUG
+      else
 	 buf = 0;
 #endif
-	 if (!rc)
-	    close();
-      }
 
       return rc;
    }
 
+   // sets a fixed read buffer size or restores adaptive sizing if size is 0; takes effect with the next read from the socket
+   DLLLOCAL void setReadBufferSize(qore_size_t size) {
+      rbuf_fixed = size;
+      rbuf_size = size ? size : DEFAULT_SOCKET_BUFSIZE;
+      rbuf_small = 0;
+   }
+
+   DLLLOCAL qore_size_t getReadBufferSize() const {
+      return rbuf_size;
+   }
+
+   // returns true if a read of the given size should bypass the read buffer and read directly into the caller's buffer
+   DLLLOCAL bool readDirect(qore_size_t bs) const {
+      return !buflen && bs >= rbuf_size;
+   }
+
+   // returns the buffer size to reserve for the next direct read of a fixed-size request with br bytes already received;
+   // the buffer grows geometrically so that memory is committed as data arrives and not for the full requested size up front
+   DLLLOCAL static qore_size_t directReadEnd(qore_size_t br, qore_size_t bufsize) {
+      qore_size_t step = br < QORE_SOCKET_MAX_ADAPTIVE_BUFSIZE ? QORE_SOCKET_MAX_ADAPTIVE_BUFSIZE : br;
+      return step < bufsize - br ? br + step : bufsize;
+   }
+
+   // returns data read with brecv() to the read buffer; the data must be at the end of the last block returned by brecv()
+   DLLLOCAL void unread(const char* buf, qore_size_t len) {
+      if (!len)
+         return;
+      assert(buf >= rbuf && buf + len <= rbuf + rbuf_alloc);
+      assert(!buflen || buf + len == rbuf + bufoffset);
+      bufoffset = buf - rbuf;
+      buflen += len;
+   }
+
+   // returns a pointer to the first '\r' or '\n' character in the buffer or the end of the buffer if there is none
+   DLLLOCAL static const char* find_eol(const char* buf, qore_size_t len) {
+      const char* nl = (const char*)memchr(buf, '\n', len);
+      const char* cr = (const char*)memchr(buf, '\r', nl ? nl - buf : len);
+      return cr ? cr : (nl ? nl : buf + len);
+   }
+
+   // splits the line at the start of the buffer; returns the start of the next line or 0 if there is no line terminator
+   /* lines end with '\n' with an optional preceding '\r'; a '\r' not followed by '\n' is part of the line unless
+      there are no more '\n' characters in the buffer
+   */
+   DLLLOCAL static char* split_line(char* buf) {
+      char* p = strchr(buf, '\n');
+      if (p) {
+         if (p > buf && p[-1] == '\r')
+            p[-1] = '\0';
+         else
+            *p = '\0';
+         return p + 1;
+      }
+      p = strchr(buf, '\r');
+      if (!p)
+         return 0;
+      *p = '\0';
+      return p + 1;
+   }
+
    //! read until \\r\\n\\r\\n and return the string
+   /* all data available in the read buffer is scanned at once, runs of characters without line terminators are copied
+      to the header string in one operation, and any data after the end of the header is left in the read buffer
+   */
    DLLLOCAL QoreStringNode* readHTTPData(ExceptionSink* xsink, const char* meth, int timeout, qore_offset_t& rc, bool exit_early = false) {
       assert(meth);
       if (sock == QORE_INVALID_SOCKET) {
@@ -1454,8 +1664,8 @@ struct qore_socket_private {
 
       while (true) {
 	 char* buf;
-	 rc = brecv(xsink, meth, buf, 1, 0, timeout, false);
-	 //printd(5, "qore_socket_private::readHTTPData() this: %p Socket::%s(): rc: "QLLD" read char: %c (%03d) (old state: %d)\n", this, meth, rc, rc > 0 && buf[0] > 31 ? buf[0] : '?', rc > 0 ? buf[0] : 0, state);
+	 rc = brecv(xsink, meth, buf, DEFAULT_SOCKET_BUFSIZE, 0, timeout, false);
+	 //printd(5, "qore_socket_private::readHTTPData() this: %p Socket::%s(): rc: "QLLD" (old state: %d)\n", this, meth, rc, state);
 	 if (rc <= 0) {
 	    //printd(5, "qore_socket_private::readHTTPData(timeout=%d) hdr='%s' (len: %d), rc="QSD", errno=%d: '%s'\n", timeout, hdr->getBuffer(), hdr->strlen(), rc, errno, strerror(errno));
 
@@ -1469,51 +1679,84 @@ struct qore_socket_private {
 	    }
 	    return 0;
 	 }
-	 char c = buf[0];
-	 if (++count == QORE_MAX_HEADER_SIZE) {
-	    if (xsink)
-	       xsink->raiseException("SOCKET-HTTP-ERROR", "header size cannot exceed "QSD" bytes", count);
-	    return 0;
-	 }
 
-	 // check if we can progress to the next state
-	 if (c == '\n') {
+	 const char* p = buf;
+	 const char* end = buf + rc;
+	 bool done = false;
+	 while (p < end) {
+	    // copy all characters up to the next line terminator character at once
 	    if (state == -1) {
-	       state = 3;
-	       continue;
-	    }
-	    if (!state) {
-               if (exit_early && hdr->empty())
-                  return 0;
-	       state = 1;
-	       continue;
+	       const char* e = find_eol(p, end - p);
+	       if (e != p) {
+		  count += e - p;
+		  if (count >= QORE_MAX_HEADER_SIZE) {
+		     if (xsink)
+			xsink->raiseException("SOCKET-HTTP-ERROR", "header size cannot exceed "QSD" bytes", (qore_size_t)QORE_MAX_HEADER_SIZE);
+		     return 0;
+		  }
+		  hdr->concat(p, e - p);
+		  p = e;
+		  continue;
+	       }
 	    }
-	    assert(state > 0);
-	    break;
-	 }
-	 else if (c == '\r') {
-	    if (state == -1) {
-	       state = 0;
-	       continue;
+
+	    char c = *(p++);
+	    if (++count == QORE_MAX_HEADER_SIZE) {
+	       if (xsink)
+		  xsink->raiseException("SOCKET-HTTP-ERROR", "header size cannot exceed "QSD" bytes", count);
+	       return 0;
 	    }
-	    if (!state)
+
+	    // check if we can progress to the next state
+	    if (c == '\n') {
+	       if (state == -1) {
+		  state = 3;
+		  continue;
+	       }
+	       if (!state) {
+		  if (exit_early && hdr->empty()) {
+		     unread(p, end - p);
+		     return 0;
+		  }
+		  state = 1;
+		  continue;
+	       }
+	       assert(state > 0);
+	       done = true;
 	       break;
-	    if (state == 1) {
-	       state = 2;
-	       continue;
 	    }
-	 }
+	    else if (c == '\r') {
+	       if (state == -1) {
+		  state = 0;
+		  continue;
+	       }
+	       if (!state) {
+		  done = true;
+		  break;
+	       }
+	       if (state == 1) {
+		  state = 2;
+		  continue;
+	       }
+	    }
 
-	 if (state != -1) {
-	    switch (state) {
-	       case 0: hdr->concat('\r'); break;
-	       case 1: hdr->concat("\r\n"); break;
-	       case 2: hdr->concat("\r\n\r"); break;
-	       case 3: hdr->concat('\n'); break;
+	    if (state != -1) {
+	       switch (state) {
+		  case 0: hdr->concat('\r'); break;
+		  case 1: hdr->concat("\r\n"); break;
+		  case 2: hdr->concat("\r\n\r"); break;
+		  case 3: hdr->concat('\n'); break;
+	       }
+	       state = -1;
 	    }
-	    state = -1;
+	    hdr->concat(c);
+	 }
+
+	 if (done) {
+	    // leave any data after the header in the buffer
+	    unread(p, end - p);
+	    break;
 	 }
-	 hdr->concat(c);
       }
       hdr->concat('\n');
 
@@ -1540,22 +1783,33 @@ struct qore_socket_private {
 
       PrivateQoreSocketThroughputHelper th(this, false);
 
-      qore_size_t bs = bufsize > 0 && bufsize < DEFAULT_SOCKET_BUFSIZE ? bufsize : DEFAULT_SOCKET_BUFSIZE;
+      qore_size_t bs = bufsize > 0 && bufsize < QORE_SOCKET_MAX_READ_BUFSIZE ? bufsize : QORE_SOCKET_MAX_READ_BUFSIZE;
 
       QoreStringNodeHolder str(new QoreStringNode(enc));
 
       char* buf;
 
       while (true) {
-	 rc = brecv(xsink, "recv", buf, bs, 0, timeout, false);
+	 // read large amounts of data directly into the string
+	 if (bufsize > 0 && readDirect(bufsize - str->size())) {
+	    qore_size_t br = str->size();
+	    qore_size_t end = directReadEnd(br, bufsize);
+	    str->reserve(end);
+	    rc = recvIntern(xsink, "recv", (char*)str->getBuffer() + br, end - br, 0, timeout);
+	    if (rc > 0)
+	       str->terminate(br + rc);
+	 }
+	 else {
+	    rc = brecv(xsink, "recv", buf, bs, 0, timeout, false);
+	    if (rc > 0)
+	       str->concat(buf, rc);
+	 }
 
 	 if (rc <= 0) {
 	    printd(5, "qore_socket_private::recv(%d, %d) bs="QSD", br="QSD", rc="QSD", errno=%d (%s)\n", bufsize, timeout, bs, str->size(), rc, errno, strerror(errno));
 	    break;
 	 }
 
-	 str->concat(buf, rc);
-
 	 // register event
 	 do_read_event(rc, str->size(), bufsize);
 
@@ -1598,7 +1852,7 @@ struct qore_socket_private {
 
       // perform first read with timeout
       char* buf;
-      rc = brecv(xsink, "recv", buf, DEFAULT_SOCKET_BUFSIZE, 0, timeout, false);
+      rc = brecv(xsink, "recv", buf, QORE_SOCKET_MAX_READ_BUFSIZE, 0, timeout, false);
       if (rc <= 0)
 	 return 0;
 
@@ -1610,7 +1864,7 @@ struct qore_socket_private {
       // keep reading data until no more data is available without a timeout
       if (isDataAvailable(0, "recv", xsink)) {
 	 do {
-	    rc = brecv(xsink, "recv", buf, DEFAULT_SOCKET_BUFSIZE, 0, 0, false);
+	    rc = brecv(xsink, "recv", buf, QORE_SOCKET_MAX_READ_BUFSIZE, 0, 0, false);
 	    //printd(5, "qore_socket_private::recv(to=%d) rc="QSD" rd="QSD"\n", timeout, rc, str->size());
 	    // if the remote end has closed the connection, return what we have
 	    if (!rc)
@@ -1651,17 +1905,34 @@ struct qore_socket_private {
 
       PrivateQoreSocketThroughputHelper th(this, false);
 
-      qore_size_t bs = bufsize > 0 && bufsize < DEFAULT_SOCKET_BUFSIZE ? bufsize : DEFAULT_SOCKET_BUFSIZE;
+      qore_size_t bs = bufsize > 0 && bufsize < QORE_SOCKET_MAX_READ_BUFSIZE ? bufsize : QORE_SOCKET_MAX_READ_BUFSIZE;
 
       SimpleRefHolder<BinaryNode> b(new BinaryNode);
 
       char* buf;
       while (true) {
-	 rc = brecv(xsink, "recvBinary", buf, bs, 0, timeout);
-	 if (rc <= 0)
-	    break;
+	 // read large amounts of data directly into the binary object
+	 if (bufsize > 0 && readDirect(bufsize - b->size())) {
+	    qore_size_t br = b->size();
+	    qore_size_t end = directReadEnd(br, bufsize);
+	    if (b->preallocate(end)) {
+	       xsink->outOfMemory();
+	       rc = -1;
+	       break;
+	    }
+	    rc = recvIntern(xsink, "recvBinary", (char*)b->getPtr() + br, end - br, 0, timeout);
+	    b->setSize(br + (rc > 0 ? rc : 0));
+	    if (rc <= 0)
+	       break;
+	    do_read_event(rc, rc);
+	 }
+	 else {
+	    rc = brecv(xsink, "recvBinary", buf, bs, 0, timeout);
+	    if (rc <= 0)
+	       break;
 
-	 b->append(buf, rc);
+	    b->append(buf, rc);
+	 }
 
 	 if (bufsize > 0) {
 	    if (b->size() >= (qore_size_t)bufsize)
@@ -1705,7 +1976,7 @@ struct qore_socket_private {
       //printd(5, "QoreSocket::recvBinary(%d, "QSD") this=%p\n", timeout, rc, this);
       // perform first read with timeout
       char* buf;
-      rc = brecv(xsink, "recvBinary", buf, DEFAULT_SOCKET_BUFSIZE, 0, timeout, false);
+      rc = brecv(xsink, "recvBinary", buf, QORE_SOCKET_MAX_READ_BUFSIZE, 0, timeout, false);
       if (rc <= 0)
 	 return 0;
 
@@ -1717,7 +1988,7 @@ struct qore_socket_private {
       // keep reading data until no more data is available without a timeout
       if (isDataAvailable(0, "recvBinary", xsink)) {
 	 do {
-	    rc = brecv(xsink, "recvBinary", buf, DEFAULT_SOCKET_BUFSIZE, 0, 0, false);
+	    rc = brecv(xsink, "recvBinary", buf, QORE_SOCKET_MAX_READ_BUFSIZE, 0, 0, false);
 	    // if the remote end has closed the connection, return what we have
 	    if (!rc)
 	       break;
@@ -1764,22 +2035,10 @@ struct qore_socket_private {
 
       const char* buf = hdr->getBuffer();
 
-      char* p;
-      if ((p = (char*)strstr(buf, "\r\n"))) {
-	 *p = '\0';
-	 p += 2;
-      }
-      else if ((p = (char*)strchr(buf, '\n'))) {
-	 *p = '\0';
-	 ++p;
-      }
-      else if ((p = (char*)strchr(buf, '\r'))) {
-	 *p = '\0';
-	 ++p;
-      }
-      // readHTTPData will only return a string that satisifies one of the above conditions,
-      // however an embedded 0 could have been sent which would make the above searches invalid
-      else {
+      char* p = split_line((char*)buf);
+      // readHTTPData will only return a string with a line terminator,
+      // however an embedded 0 could have been sent which would make the above search invalid
+      if (!p) {
 	 if (xsink)
 	    xsink->raiseException("SOCKET-HTTP-ERROR", "invalid header received with embedded nulls in Socket::readHTTPHeader()");
 	 return 0;
@@ -1945,8 +2204,10 @@ struct qore_socket_private {
 
          //printd(5, "qore_socket_private::sendHttpChunkedWithCallback() this: %p res: %s\n", this, get_type_name(*res));
 
-         // check callback return val
+         // check callback return val; chunk data is sent directly from the value returned
          QoreString buf;
+         const char* data = 0;
+         qore_size_t size = 0;
 
          switch (res->getType()) {
             case NT_STRING: {
@@ -1956,7 +2217,8 @@ struct qore_socket_private {
                   break;
                }
                buf.sprintf("%x\r\n", (int)str->size());
-               buf.concat(str->getBuffer(), str->size());
+               data = str->getBuffer();
+               size = str->size();
                break;
             }
 
@@ -1967,7 +2229,8 @@ struct qore_socket_private {
                   break;
                }
                buf.sprintf("%x\r\n", (int)b->size());
-               buf.concat((const char*)b->getPtr(), b->size());
+               data = (const char*)b->getPtr();
+               size = b->size();
                break;
             }
 
@@ -2007,11 +2270,16 @@ struct qore_socket_private {
          if (buf.empty())
             buf.concat("0\r\n");
 
-         // add trailing \r\n
-         buf.concat("\r\n");
-
-         // send chunk buffer data
-         rc = sendIntern(xsink, mname, buf.getBuffer(), buf.size(), timeout_ms, total);
+         // send the chunk size line, chunk data, and trailing \r\n together
+         if (data) {
+            qore_send_buf bufs[3] = {{buf.getBuffer(), buf.size()}, {data, size}, {"\r\n", 2}};
+            rc = sendvIntern(xsink, mname, bufs, 3, timeout_ms, total);
+         }
+         else {
+            // add trailing \r\n
+            buf.concat("\r\n");
+            rc = sendIntern(xsink, mname, buf.getBuffer(), buf.size(), timeout_ms, total);
+         }
 
          //printd(5, "qore_socket_private::sendHttpChunkedWithCallback() this: %p sent: %s\n", this, buf.getBuffer());
 
@@ -2024,13 +2292,51 @@ struct qore_socket_private {
       return rc < 0 || sock == QORE_INVALID_SOCKET ? -1 : 0;
    }
 
-   DLLLOCAL int sendIntern(ExceptionSink* xsink, const char* mname, const char* buf, qore_size_t size, int timeout_ms, int64& total) {
+   // handles an error sending data on a non-SSL socket
+   /** returns 0 if the send should be retried, 1 if it failed (in which case rc is set accordingly), or -1 if an exception was raised while waiting for the socket to become writable
+   */
+   DLLLOCAL int sendError(ExceptionSink* xsink, const char* mname, int timeout_ms, qore_offset_t& rc) {
+      sock_get_error();
+      // check that the send finishes before the timeout if we are using non-blocking I/O
+      if (timeout_ms >= 0 && (errno == EAGAIN
+#ifdef EWOULDBLOCK
+                              || errno == EWOULDBLOCK
+#endif
+             )) {
+         if (!isWriteFinished(timeout_ms, mname, xsink)) {
+            if (xsink) {
+               if (*xsink)
+                  return -1;
+               se_timeout(mname, timeout_ms, xsink);
+            }
+            rc = QSE_TIMEOUT;
+            return 1;
+         }
+         return 0;
+      }
+      // try again if we were interrupted by a signal
+      if (errno == EINTR)
+         return 0;
+
+      //printd(5, "qore_socket_private::sendError() rc: "QSD" errno: %d sock: %d\n", rc, errno, sock);
+      if (xsink)
+         xsink->raiseErrnoException("SOCKET-SEND-ERROR", errno, "error while executing Socket::%s()", mname);
+
+#ifdef EPIPE
+      if (errno == EPIPE)
+         close();
+#endif
+#ifdef ECONNRESET
+      if (errno == ECONNRESET)
+         close();
+#endif
+      return 1;
+   }
+
+   DLLLOCAL int sendIntern(ExceptionSink* xsink, const char* mname, const char* buf, qore_size_t size, int timeout_ms, int64& total, int flags = 0) {
       qore_offset_t rc;
       qore_size_t bs = 0;
 
-      // set the non-blocking flag (for use with non-ssl connections)
-      bool nb = (timeout_ms >= 0);
-
       while (true) {
          if (ssl) {
             // SSL_MODE_ENABLE_PARTIAL_WRITE is enabled so we can get finer-grained socket events for do_send_event() below
@@ -2038,45 +2344,15 @@ struct qore_socket_private {
          }
          else {
             while (true) {
-               rc = ::send(sock, buf + bs, size - bs, 0);
-               //printd(5, "qore_socket_private::send() this: %p Socket::%s() buf: %p size: "QLLD" timeout_ms: %d ssl: %p nb: %d bs: "QLLD" rc: "QLLD"\n", this, mname, buf, size, timeout_ms, ssl, nb, bs, rc);
-               // try again if we were interrupted by a signal
+               rc = ::send(sock, buf + bs, size - bs, flags);
+               //printd(5, "qore_socket_private::send() this: %p Socket::%s() buf: %p size: "QLLD" timeout_ms: %d ssl: %p bs: "QLLD" rc: "QLLD"\n", this, mname, buf, size, timeout_ms, ssl, bs, rc);
                if (rc >= 0)
                   break;
-	       sock_get_error();
-               // check that the send finishes before the timeout if we are using non-blocking I/O
-               if (nb && (errno == EAGAIN
-#ifdef EWOULDBLOCK
-			  || errno == EWOULDBLOCK
-#endif
-		      )) {
-                  if (!isWriteFinished(timeout_ms, mname, xsink)) {
-                     if (xsink) {
-			if (*xsink)
-			   return -1;
-                        se_timeout(mname, timeout_ms, xsink);
-		     }
-                     rc = QSE_TIMEOUT;
-                     break;
-                  }
-                  continue;
-               }
-               if (errno != EINTR) {
-		  //printd(5, "qore_socket_private::send() bs: %ld rc: "QSD" len: "QSD" (total: "QSD") errno: %d sock: %d\n", bs, rc, size - bs, size, errno, sock);
-                  if (xsink)
-                     xsink->raiseErrnoException("SOCKET-SEND-ERROR", errno, "error while executing Socket::%s()", mname);
-
-#ifdef EPIPE
-		  if (errno == EPIPE)
-		     close();
-#endif
-#ifdef ECONNRESET
-		  if (errno == ECONNRESET)
-		     close();
-#endif
-
+               int erc = sendError(xsink, mname, timeout_ms, rc);
+               if (erc < 0)
+                  return -1;
+               if (erc)
                   break;
-               }
             }
          }
 
@@ -2097,7 +2373,87 @@ struct qore_socket_private {
       return rc;
    }
 
-   DLLLOCAL int send(ExceptionSink* xsink, const char* mname, const char* buf, qore_size_t size, int timeout_ms = -1) {
+   // sends several buffers as a single message
+   /** on non-SSL connections the buffers are sent with writev() so that a small message needs only one system call;
+       with SSL small messages are copied into a single buffer so that they are sent in one record
+   */
+   DLLLOCAL int sendvIntern(ExceptionSink* xsink, const char* mname, const qore_send_buf* bufs, int cnt, int timeout_ms, int64& total) {
+      assert(cnt <= QORE_SOCKET_MAX_IOV);
+      qore_size_t size = 0;
+      for (int i = 0; i < cnt; ++i)
+         size += bufs[i].size;
+
+#ifndef _Q_WINDOWS
+      if (!ssl) {
+         struct iovec iov[QORE_SOCKET_MAX_IOV];
+         int iovcnt = 0;
+         for (int i = 0; i < cnt; ++i) {
+            if (!bufs[i].size)
+               continue;
+            iov[iovcnt].iov_base = (void*)bufs[i].buf;
+            iov[iovcnt].iov_len = bufs[i].size;
+            ++iovcnt;
+         }
+
+         struct iovec* v = iov;
+         qore_offset_t rc = 0;
+         qore_size_t bs = 0;
+         while (bs < size) {
+            while (true) {
+               rc = ::writev(sock, v, iovcnt);
+               //printd(5, "qore_socket_private::sendvIntern() this: %p Socket::%s() size: "QLLD" iovcnt: %d bs: "QLLD" rc: "QLLD"\n", this, mname, size, iovcnt, bs, rc);
+               if (rc >= 0)
+                  break;
+               int erc = sendError(xsink, mname, timeout_ms, rc);
+               if (erc < 0)
+                  return -1;
+               if (erc)
+                  break;
+            }
+
+            total += rc;
+            if (rc < 0 || sock == QORE_INVALID_SOCKET)
+               break;
+
+            bs += rc;
+            do_send_event(rc, bs, size);
+
+            // skip the data already sent
+            qore_size_t n = rc;
+            while (iovcnt && n >= v->iov_len) {
+               n -= v->iov_len;
+               ++v;
+               --iovcnt;
+            }
+            if (n) {
+               v->iov_base = (char*)v->iov_base + n;
+               v->iov_len -= n;
+            }
+         }
+         return rc;
+      }
+#endif
+
+      if (size <= QORE_SSL_GATHER_SIZE) {
+         QoreString str;
+         str.reserve(size);
+         for (int i = 0; i < cnt; ++i)
+            str.concat(bufs[i].buf, bufs[i].size);
+         return sendIntern(xsink, mname, str.getBuffer(), str.size(), timeout_ms, total);
+      }
+
+      int rc = 0;
+      for (int i = 0; i < cnt; ++i) {
+         if (!bufs[i].size)
+            continue;
+         rc = sendIntern(xsink, mname, bufs[i].buf, bufs[i].size, timeout_ms, total);
+         if (rc < 0 || sock == QORE_INVALID_SOCKET)
+            break;
+      }
+      return rc;
+   }
+
+   DLLLOCAL int send(ExceptionSink* xsink, const char* mname, const char* buf, qore_size_t size, int timeout_ms = -1, int flags = 0) {
       if (sock == QORE_INVALID_SOCKET) {
 	 if (xsink)
 	    se_not_open(mname, xsink);
@@ -2120,12 +2476,149 @@ struct qore_socket_private {
          return -1;
 
       int64 total = 0;
-      qore_offset_t rc = sendIntern(xsink, mname, buf, size, timeout_ms, total);
+      qore_offset_t rc = sendIntern(xsink, mname, buf, size, timeout_ms, total, flags);
       th.finalize(total);
 
       return rc < 0 || sock == QORE_INVALID_SOCKET ? rc : 0;
    }
 
+   DLLLOCAL int sendv(ExceptionSink* xsink, const char* mname, const qore_send_buf* bufs, int cnt, int timeout_ms = -1) {
+      if (sock == QORE_INVALID_SOCKET) {
+	 if (xsink)
+	    se_not_open(mname, xsink);
+
+	 return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         if (xsink)
+            se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+
+      PrivateQoreSocketThroughputHelper th(this, true);
+
+      // set the non-blocking flag (for use with non-ssl connections)
+      bool nb = (timeout_ms >= 0);
+      // set non-blocking I/O (and restore on exit) if we have a timeout and a non-ssl connection
+      OptionalNonBlockingHelper onbh(*this, !ssl && nb, xsink);
+      if (*xsink)
+         return -1;
+
+      int64 total = 0;
+      qore_offset_t rc = sendvIntern(xsink, mname, bufs, cnt, timeout_ms, total);
+      th.finalize(total);
+
+      return rc < 0 || sock == QORE_INVALID_SOCKET ? rc : 0;
+   }
+
+   // sends len bytes of data from the given file descriptor starting at offset; the file position is not changed
+   /** on non-SSL connections the data is sent with sendfile() where available, so it is not copied through user space;
+       otherwise it is read into a buffer and sent in blocks
+
+       @return the number of bytes sent or -1 if an exception was raised
+   */
+   DLLLOCAL int64 sendFile(ExceptionSink* xsink, const char* mname, int fd, int64 offset, int64 len, int timeout_ms = -1) {
+      assert(xsink);
+      if (sock == QORE_INVALID_SOCKET) {
+         se_not_open(mname, xsink);
+         return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+
+      if (len < 0) {
+         struct stat sbuf;
+         if (fstat(fd, &sbuf)) {
+            xsink->raiseErrnoException("SOCKET-SENDFILE-ERROR", errno, "Socket::%s(): cannot determine the size of the file", mname);
+            return -1;
+         }
+         len = sbuf.st_size - offset;
+      }
+      if (len <= 0)
+         return 0;
+
+      PrivateQoreSocketThroughputHelper th(this, true);
+
+      // set non-blocking I/O (and restore on exit) if we have a timeout and a non-ssl connection
+      OptionalNonBlockingHelper onbh(*this, !ssl && timeout_ms >= 0, xsink);
+      if (*xsink)
+         return -1;
+
+      int64 total = 0;
+      int rc = sendFileIntern(xsink, mname, fd, offset, len, timeout_ms, total);
+      th.finalize(total);
+
+      return rc < 0 || *xsink ? -1 : total;
+   }
+
+   DLLLOCAL int sendFileIntern(ExceptionSink* xsink, const char* mname, int fd, int64 offset, int64 len, int timeout_ms, int64& total) {
+#ifdef HAVE_SYS_SENDFILE_H
+      if (!ssl) {
+         off_t off = offset;
+         while (total < len) {
+            qore_size_t bn = len - total > QORE_SENDFILE_MAX ? QORE_SENDFILE_MAX : len - total;
+            qore_offset_t rc = ::sendfile(sock, fd, &off, bn);
+            //printd(5, "qore_socket_private::sendFileIntern() this: %p Socket::%s() off: "QLLD" bn: "QLLD" rc: "QLLD"\n", this, mname, (int64)off, (int64)bn, rc);
+            if (!rc)
+               break;
+            if (rc < 0) {
+               // fall back to reading the data if sendfile() is not supported for this file
+               if (!total && (errno == EINVAL || errno == ENOSYS))
+                  break;
+               int erc = sendError(xsink, mname, timeout_ms, rc);
+               if (erc < 0)
+                  return -1;
+               if (erc)
+                  return rc;
+               continue;
+            }
+
+            total += rc;
+            do_send_event(rc, total, len);
+            if (sock == QORE_INVALID_SOCKET)
+               return -1;
+         }
+         if (total)
+            return 0;
+      }
+#endif
+
+      SimpleRefHolder<BinaryNode> b(new BinaryNode);
+      qore_size_t bufsize = len > QORE_SENDFILE_BUFSIZE ? QORE_SENDFILE_BUFSIZE : len;
+      if (b->preallocate(bufsize)) {
+         xsink->outOfMemory();
+         return -1;
+      }
+      char* buf = (char*)b->getPtr();
+
+      while (total < len) {
+         qore_size_t bn = len - total > (int64)bufsize ? bufsize : len - total;
+#ifdef _Q_WINDOWS
+         qore_offset_t rc = lseek(fd, offset + total, SEEK_SET) < 0 ? -1 : ::read(fd, buf, bn);
+#else
+         qore_offset_t rc = ::pread(fd, buf, bn, offset + total);
+#endif
+         if (!rc)
+            break;
+         if (rc < 0) {
+            if (errno == EINTR)
+               continue;
+            xsink->raiseErrnoException("SOCKET-SENDFILE-ERROR", errno, "Socket::%s(): error reading file data", mname);
+            return -1;
+         }
+
+         int64 sent = 0;
+         rc = sendIntern(xsink, mname, buf, rc, timeout_ms, sent);
+         total += sent;
+         if (rc < 0 || sock == QORE_INVALID_SOCKET)
+            return -1;
+      }
+
+      return 0;
+   }
+
    DLLLOCAL int sendHttpMessage(ExceptionSink* xsink, QoreHashNode* info, const char* method, const char* path, const char* http_version, const QoreHashNode* headers, const void *data, qore_size_t size, const ResolvedCallReferenceNode* send_callback, int source, int timeout_ms = -1, QoreThreadLock* l = 0, bool* aborted = 0) {
       assert(!(data && send_callback));
       // prepare header string
@@ -2145,13 +2638,18 @@ struct qore_socket_private {
 
       //printd(5, "qore_socket_private::sendHttpMessage() hdr: %s\n", hdr.getBuffer());
 
+      // send the header and the body together
+      if (size && data) {
+         qore_send_buf bufs[2] = {{hdr.getBuffer(), hdr.strlen()}, {(const char*)data, size}};
+         return sendv(xsink, "sendHTTPMessage", bufs, 2, timeout_ms);
+      }
+
+      // if a chunked body follows, the header is held back until the first chunk is sent
       int rc;
-      if ((rc = send(xsink, "sendHTTPMessage", hdr.getBuffer(), hdr.strlen(), timeout_ms)))
+      if ((rc = send(xsink, "sendHTTPMessage", hdr.getBuffer(), hdr.strlen(), timeout_ms, send_callback ? QORE_MSG_MORE : 0)))
 	 return rc;
 
-      if (size && data)
-         return send(xsink, "sendHTTPMessage", (char*)data, size, timeout_ms);
-      else if (send_callback) {
+      if (send_callback) {
          assert(l);
          assert(!aborted || !(*aborted));
          return sendHttpChunkedWithCallback(xsink, "sendHTTPMessage", *send_callback, *l, source, timeout_ms, aborted);
@@ -2175,13 +2673,18 @@ struct qore_socket_private {
 
       //printd(5, "QoreSocket::sendHTTPResponse() this: %p data: %p size: %ld send_callback: %p hdr: %s", this, data, size, send_callback, hdr.getBuffer());
 
+      // send the header and the body together
+      if (size && data) {
+         qore_send_buf bufs[2] = {{hdr.getBuffer(), hdr.strlen()}, {(const char*)data, size}};
+         return sendv(xsink, "sendHTTPResponse", bufs, 2, timeout_ms);
+      }
+
+      // if a chunked body follows, the header is held back until the first chunk is sent
       int rc;
-      if ((rc = send(xsink, "sendHTTPResponse", hdr.getBuffer(), hdr.strlen(), timeout_ms)))
+      if ((rc = send(xsink, "sendHTTPResponse", hdr.getBuffer(), hdr.strlen(), timeout_ms, send_callback ? QORE_MSG_MORE : 0)))
 	 return rc;
 
-      if (size && data)
-         return send(xsink, "sendHTTPResponse", (char*)data, size, timeout_ms);
-      else if (send_callback) {
+      if (send_callback) {
          assert(l);
          assert(!aborted || !(*aborted));
          return sendHttpChunkedWithCallback(xsink, "sendHTTPResponse", *send_callback, *l, source, timeout_ms, aborted);
@@ -2596,19 +3099,7 @@ struct qore_socket_private {
       while (*p) {
 	 char* buf = p;
 
-	 if ((p = strstr(buf, "\r\n"))) {
-	    *p = '\0';
-	    p += 2;
-	 }
-	 else if ((p = strchr(buf, '\n'))) {
-	    *p = '\0';
-	    p++;
-	 }
-	 else if ((p = strchr(buf, '\r'))) {
-	    *p = '\0';
-	    p++;
-	 }
-	 else
+	 if (!(p = split_line(buf)))
 	    break;
 	 char* t = strchr(buf, ':');
 	 if (!t)
@@ -67,6 +67,11 @@
 #endif // CPU_X86_64
 #endif // QORE_STACK_GUARD
 
+// the minimum stack size that can be set for new threads with set_thread_stack_size()
+#ifndef QORE_THREAD_STACK_MIN
+#define QORE_THREAD_STACK_MIN (1024 * 64)
+#endif
+
 class Operator;
 class Context;
 class CVNode;
@@ -403,6 +408,10 @@ DLLLOCAL int get_signal_thread_entry();
 DLLLOCAL void deregister_signal_thread();
 DLLLOCAL void register_thread(int tid, pthread_t ptid, QoreProgram* pgm, bool foreign = false);
 DLLLOCAL void deregister_thread(int tid);
+// returns the stack size for new threads
+DLLLOCAL size_t q_get_thread_stack_size();
+// sets the stack size for new threads (0 = the default stack size), returns -1 if an exception was raised
+DLLLOCAL int q_set_thread_stack_size(size_t ssize, ExceptionSink* xsink);
 DLLLOCAL void delete_signal_thread();
 
 // returns 1 if data structure is already on stack, 0 if not (=OK)
@@ -790,9 +799,13 @@ public:
    DLLLOCAL QoreHashNode* getInfo() const;
 };
 
+// the call stack is an intrusive list of CallNode frames allocated on the C++ stack of the owning thread;
+// it is accessed without any thread list lookup through the pointer in the thread's ThreadData
+// the per-stack lock is only contended when another thread reads the stack in getAllCallStacks()
 class CallStack {
 private:
    CallNode* tail;
+   mutable QoreThreadLock l;
 
 public:
    DLLLOCAL CallStack();
@@ -34,6 +34,12 @@
 #ifndef _QORE_VAR_RWLOCK_PRIV_H
 #define _QORE_VAR_RWLOCK_PRIV_H
 
+#ifdef __GNUC__
+// optimistic reads are supported: readers check the write sequence count instead of acquiring the lock
+#define QORE_VAR_RWLOCK_SEQ 1
+#define qore_var_rwlock_barrier() __sync_synchronize()
+#endif
+
 class qore_var_rwlock_priv {
 protected:
    DLLLOCAL virtual void notifyIntern() {
@@ -53,9 +59,46 @@ public:
    QoreCondition write_cond,
       read_cond;
    bool has_notify;
+   // write sequence count: odd while the write lock is held, incremented only with the mutex held
+   volatile unsigned seq;
 
    //! creates and initializes the lock
-   DLLLOCAL qore_var_rwlock_priv() : write_tid(-1), readers(0), read_waiting(0), write_waiting(0), has_notify(false) {
+   DLLLOCAL qore_var_rwlock_priv() : write_tid(-1), readers(0), read_waiting(0), write_waiting(0), has_notify(false), seq(0) {
+   }
+
+   //! called with the mutex held when the write lock is acquired
+   DLLLOCAL void writeBegin() {
+      ++seq;
+#ifdef QORE_VAR_RWLOCK_SEQ
+      // make sure the odd sequence count is visible before any data is changed
+      qore_var_rwlock_barrier();
+#endif
+   }
+
+   //! called with the mutex held when the write lock is released
+   DLLLOCAL void writeEnd() {
+#ifdef QORE_VAR_RWLOCK_SEQ
+      // make sure all changes are visible before the even sequence count
+      qore_var_rwlock_barrier();
+#endif
+      ++seq;
+   }
+
+   //! returns the current sequence count for an optimistic read; an odd value means that a write is in progress
+   DLLLOCAL unsigned readSeqBegin() const {
+      unsigned s = seq;
+#ifdef QORE_VAR_RWLOCK_SEQ
+      qore_var_rwlock_barrier();
+#endif
+      return s;
+   }
+
+   //! returns true if the data read since readSeqBegin() may be inconsistent and must be read again with the lock held
+   DLLLOCAL bool readSeqRetry(unsigned s) const {
+#ifdef QORE_VAR_RWLOCK_SEQ
+      qore_var_rwlock_barrier();
+#endif
+      return s != seq;
    }
 
    //! destroys the lock
@@ -75,6 +118,7 @@ public:
       }
 
       write_tid = tid;
+      writeBegin();
    }
 
    //! tries to grab the write lock; does not block if unsuccessful; returns 0 if successful
@@ -86,6 +130,7 @@ public:
 	 return -1;
 
       write_tid = tid;
+      writeBegin();
       return 0;
    }
 
@@ -94,6 +139,7 @@ public:
       int tid = gettid();
       AutoLocker al(l);
       if (write_tid == tid) {
+         writeEnd();
          write_tid = -1;
 	 if (has_notify)
 	    notifyIntern();
@@ -31,6 +31,134 @@
 #include <qore/Qore.h>
 #include <qore/intern/AbstractSmartLock.h>
 
+#include <set>
+#include <map>
+#include <functional>
+
+volatile bool qore_lock_profiling = false;
+
+typedef std::set<QoreLockStats*> lock_stats_set_t;
+
+// the set of all lock statistics for the contention report
+static lock_stats_set_t lock_stats_set;
+static QoreThreadLock lock_stats_lock;
+
+static void q_loc_to_string(const QoreProgramLocation& loc, std::string& str) {
+   QoreString tmp;
+   loc.toString(tmp);
+   str = tmp.getBuffer();
+}
+
+bool set_lock_contention_profiling(bool enable) {
+   AutoLocker al(lock_stats_lock);
+   bool rv = qore_lock_profiling;
+   qore_lock_profiling = enable;
+   return rv;
+}
+
+QoreListNode* get_lock_contention_report() {
+   typedef std::multimap<int64, QoreHashNode*, std::greater<int64> > lock_report_map_t;
+   lock_report_map_t rmap;
+
+   {
+      AutoLocker al(lock_stats_lock);
+      for (lock_stats_set_t::iterator i = lock_stats_set.begin(), e = lock_stats_set.end(); i != e; ++i) {
+         int64 total;
+         {
+            AutoLocker al2((*i)->m);
+            total = (*i)->total_wait_us;
+         }
+         rmap.insert(lock_report_map_t::value_type(total, (*i)->getHash()));
+      }
+   }
+
+   QoreListNode* l = new QoreListNode;
+   for (lock_report_map_t::iterator i = rmap.begin(), e = rmap.end(); i != e; ++i)
+      l->push(i->second);
+   return l;
+}
+
+QoreLockStats::QoreLockStats(const char* n, const QoreProgramLocation& l) : name(n), acquisitions(0), contended(0), total_wait_us(0), max_wait_us(0) {
+   q_loc_to_string(l, loc);
+}
+
+void QoreLockStats::add(bool n_contended, int64 wait_us, const std::string& holder, const QoreProgramLocation& waiter) {
+   AutoLocker al(m);
+   ++acquisitions;
+   if (!n_contended)
+      return;
+
+   ++contended;
+   total_wait_us += wait_us;
+   if (wait_us > max_wait_us) {
+      max_wait_us = wait_us;
+      max_wait_holder = holder;
+      q_loc_to_string(waiter, max_wait_waiter);
+   }
+}
+
+QoreHashNode* QoreLockStats::getHash() const {
+   QoreHashNode* h = new QoreHashNode;
+   AutoLocker al(m);
+   h->setKeyValue("name", new QoreStringNode(name), 0);
+   h->setKeyValue("location", loc.empty() ? 0 : new QoreStringNode(loc), 0);
+   h->setKeyValue("acquisitions", new QoreBigIntNode(acquisitions), 0);
+   h->setKeyValue("contended", new QoreBigIntNode(contended), 0);
+   h->setKeyValue("total_wait_us", new QoreBigIntNode(total_wait_us), 0);
+   h->setKeyValue("max_wait_us", new QoreBigIntNode(max_wait_us), 0);
+   h->setKeyValue("max_wait_holder", max_wait_holder.empty() ? 0 : new QoreStringNode(max_wait_holder), 0);
+   h->setKeyValue("max_wait_waiter", max_wait_waiter.empty() ? 0 : new QoreStringNode(max_wait_waiter), 0);
+   return h;
+}
+
+QoreLockProfileHelper::QoreLockProfileHelper(AbstractSmartLock* a, VLock* n_nvl) : asl(qore_lock_profiling ? a : 0), nvl(n_nvl) {
+   if (!asl)
+      return;
+   waits = nvl->getWaits();
+   start = q_clock_getmicros();
+   if (asl->stats)
+      holder = asl->stats->holder_loc;
+}
+
+void QoreLockProfileHelper::acquired() {
+   if (!asl)
+      return;
+
+   bool contended = nvl->getWaits() != waits;
+   int64 wait_us = contended ? q_clock_getmicros() - start : 0;
+   QoreProgramLocation loc(RunTimeLocation);
+
+   if (!asl->stats) {
+      asl->stats = new QoreLockStats(asl->getName(), loc);
+      AutoLocker al(lock_stats_lock);
+      lock_stats_set.insert(asl->stats);
+   }
+
+   asl->stats->add(contended, wait_us, holder, loc);
+   q_loc_to_string(loc, asl->stats->holder_loc);
+}
+
+AbstractSmartLock::~AbstractSmartLock() {
+   if (stats) {
+      {
+         AutoLocker al(lock_stats_lock);
+         lock_stats_set.erase(stats);
+      }
+      delete stats;
+   }
+}
+
+QoreHashNode* AbstractSmartLock::getStats() const {
+   AutoLocker al(&asl_lock);
+   if (stats)
+      return stats->getHash();
+
+   QoreProgramLocation loc;
+   QoreLockStats tmp(getName(), loc);
+   tmp.loc.clear();
+   return tmp.getHash();
+}
+
 void AbstractSmartLock::cleanupImpl() {
    if (tid == gettid())
       release_and_signal();
@@ -118,9 +246,12 @@ int AbstractSmartLock::grab(ExceptionSink *xsink, int64 timeout_ms) {
    
    VLock *nvl = getVLock();
    AutoLocker al(&asl_lock);
+   QoreLockProfileHelper lph(this, nvl);
    int rc = grabImpl(mtid, nvl, xsink, timeout_ms);
-   if (!rc)
+   if (!rc) {
       grab_intern(mtid, nvl);
+      lph.acquired();
+   }
    return rc;
 }
 
@@ -128,9 +259,12 @@ int AbstractSmartLock::tryGrab() {
    int mtid = gettid();
    VLock *nvl = getVLock();
    AutoLocker al(&asl_lock);
+   QoreLockProfileHelper lph(this, nvl);
    int rc = tryGrabImpl(mtid, nvl);
-   if (!rc)
+   if (!rc) {
       grab_intern(mtid, nvl);
+      lph.acquired();
+   }
    return rc;
 }
 
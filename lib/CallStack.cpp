@@ -30,17 +30,6 @@
 
 #include <qore/Qore.h>
 
-// a read-write lock is used in an inverted fashion to provide thread-safe
-// access to call stacks: writing to each call stack is performed within
-// the read lock, reading all threads' stacks is performed in the write lock
-#include <qore/QoreRWLock.h>
-
-#ifdef _Q_WINDOWS
-QoreRWLock *thread_stack_lock;
-#else
-QoreRWLock thread_stack_lock;
-#endif
-
 CallNode::CallNode(const char *f, int t, ClassObj o) : func(f), loc(RunTimeLocation), type(t), obj(o) {
    // we do not reference the object here, because the object is already referenced by CodeContextHelper
    // which is always used with this class
@@ -103,18 +92,15 @@ CallStack::CallStack() {
 }
 
 CallStack::~CallStack() {
-   while (tail) {
-      CallNode *c = tail->prev;
-      delete tail;
-      tail = c;
-   }
+   // call nodes are allocated on the C++ stack of the owning thread and are not owned by the call stack
 }
 
 void CallStack::push(CallNode *c) {
    QORE_TRACE("CallStack::push()");
    c->next = 0;
    c->prev = tail;
-   QoreAutoRWReadLocker l(thread_stack_lock);
+   // the lock is local to the current thread's stack and is only contended in getAllCallStacks()
+   AutoLocker al(l);
    if (tail)
       tail->next = c;
    tail = c;
@@ -122,22 +108,23 @@ void CallStack::push(CallNode *c) {
 
 void CallStack::pop(ExceptionSink *xsink) {
    QORE_TRACE("CallStack::pop()");
-   {
-      QoreAutoRWReadLocker l(thread_stack_lock);
-      tail = tail->prev;
-      if (tail)
-	 tail->next = 0;
-   }
+   AutoLocker al(l);
+   tail = tail->prev;
+   if (tail)
+      tail->next = 0;
 }
 
 QoreListNode *CallStack::getCallStack() const {
-   QoreListNode *l = new QoreListNode;
+   QoreListNode *rv = new QoreListNode;
+   // this function can be called from another thread, in which case the lock ensures that the frames
+   // being read are not popped from the owning thread's C++ stack while we are reading them
+   AutoLocker al(l);
    CallNode *c = tail;
    while (c) {
-      l->push(c->getInfo());
+      rv->push(c->getInfo());
       c = c->prev;
    }
-   return l;
+   return rv;
 }
 
 void CallStack::substituteObjectIfEqual(QoreObject *o) {
@@ -256,7 +256,7 @@ ConstantList::ConstantList(const ConstantList& old, int64 po, ClassNs p) : ptr(p
    for (cnemap_t::const_iterator i = old.cnemap.begin(), e = old.cnemap.end(); i != e; ++i) {
       assert(i->second->init);
       // only check copying criteria when copying a constant list in a namespace
-      if (p.isNs()) {
+      if (p.isNs() && !(po & PO_INTERN_CLONE)) {
 	 // check the public flag
 	 if (!i->second->pub)
 	    continue;
@@ -54,6 +54,12 @@ FunctionList::FunctionList(const FunctionList& old, qore_ns_private* ns, int64 p
    bool no_builtin = po & PO_NO_SYSTEM_FUNC_VARIANTS;
    for (fl_map_t::const_iterator i = old.begin(), e = old.end(); i != e; ++i) {
       QoreFunction* f = i->second->getFunction();
+      if (po & PO_INTERN_CLONE) {
+         // program clones get all variants of all functions with the same injection flag
+         FunctionEntry* fe = new FunctionEntry(i->first, new QoreFunction(*f, po, ns, true, f->injected()));
+         insert(std::make_pair(fe->getName(), fe));
+         continue;
+      }
       if (!f->hasBuiltin()) {
          if (no_user || !f->hasUserPublic())
             continue;
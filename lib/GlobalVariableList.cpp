@@ -43,6 +43,12 @@ GlobalVariableList::GlobalVariableList(const GlobalVariableList& old, int64 po)
    map_var_t::iterator last = vmap.begin();
    for (map_var_t::const_iterator i = old.vmap.begin(), e = old.vmap.end(); i != e; ++i) {
       //printd(5, "GlobalVariableList::GlobalVariableList() this: %p v: %p '%s' pub: %d\n", this, i->second, i->second->getName(), i->second->isPublic());
+      // program clones get independent copies of all global variables
+      if (po & PO_INTERN_CLONE) {
+         Var* v = i->second->copy();
+         last = vmap.insert(last, map_var_t::value_type(v->getName(), v));
+         continue;
+      }
       if (!i->second->isPublic())
 	 continue;
       Var* v = new Var(const_cast<Var*>(i->second));
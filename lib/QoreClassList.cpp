@@ -82,6 +82,15 @@ const QoreClass* QoreClassList::find(const char *name) const {
 
 QoreClassList::QoreClassList(const QoreClassList& old, int64 po, qore_ns_private* ns) {
    for (hm_qc_t::const_iterator i = old.hm.begin(), e = old.hm.end(); i != e; ++i) {
+      if (po & PO_INTERN_CLONE) {
+         // program clones get all classes with the same public flag
+         QoreClass* qc = new QoreClass(*i->second);
+         qore_class_private::setNamespace(qc, ns);
+         if (qore_class_private::isPublic(*i->second))
+            qore_class_private::setPublic(*qc);
+         addInternal(qc);
+         continue;
+      }
       if (!i->second->isSystem()) {
          //printd(5, "QoreClassList::QoreClassList() this: %p c: %p '%s' po & PO_NO_INHERIT_USER_CLASSES: %s pub: %s\n", this, i->second, i->second->getName(), po & PO_NO_INHERIT_USER_CLASSES ? "true": "false", qore_class_private::isPublic(*i->second) ? "true": "false");
          if (po & PO_NO_INHERIT_USER_CLASSES || !qore_class_private::isPublic(*i->second))
@@ -214,9 +214,13 @@ int fsync (int fd) {
 int QoreFile::sync() {
    AutoLocker al(priv->m);
 
-   if (priv->is_open)
-      return ::fsync(priv->fd);
-   return -1;
+   if (!priv->is_open)
+      return -1;
+
+   if (priv->flushWriteBuffer())
+      return -1;
+
+   return ::fsync(priv->fd);
 }
 
 void QoreFile::makeSpecial(int sfd) {
@@ -290,8 +294,8 @@ qore_size_t QoreFile::setPos(qore_size_t pos) {
 
    if (!priv->is_open)
       return -1;
-   
-   return lseek(priv->fd, pos, SEEK_SET);
+
+   return priv->setPosIntern(pos);
 }
 
 // FIXME: deleteme
@@ -779,11 +783,36 @@ bool QoreFile::isOpen() const {
    return priv->isOpen();
 }
 
+int QoreFile::map(ExceptionSink *xsink) {
+   return priv->map(xsink);
+}
+
+bool QoreFile::isMapped() const {
+   return priv->isMapped();
+}
+
+int QoreFile::flush(ExceptionSink *xsink) {
+   return priv->flush(xsink);
+}
+
+int QoreFile::setWriteBufferSize(int64 size, ExceptionSink *xsink) {
+   return priv->setWriteBufferSize(size, xsink);
+}
+
+int64 QoreFile::getWriteBufferSize() const {
+   return priv->getWriteBufferSize();
+}
+
 bool QoreFile::isDataAvailable(int timeout_ms, ExceptionSink *xsink) const {
    return priv->isDataAvailable(timeout_ms, xsink);
 }
 
 int QoreFile::getFD() const {
+   // the descriptor's position and contents must match the file's for external reads
+   AutoLocker al(priv->m);
+   priv->syncReadBuffer();
+   if (priv->is_open)
+      priv->flushWriteBuffer();
    return priv->fd;
 }
 
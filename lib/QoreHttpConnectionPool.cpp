@@ -0,0 +1,382 @@
+/*
+  QoreHttpConnectionPool.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+
+#include <qore/Qore.h>
+#include <qore/QoreURL.h>
+#include <qore/intern/QoreHttpConnectionPool.h>
+
+#include <string.h>
+#include <ctype.h>
+
+QoreHttpConnectionPool::QoreHttpConnectionPool(const QoreHashNode* n_opts, ExceptionSink* xsink) :
+   opts(n_opts ? n_opts->hashRefSelf() : new QoreHashNode), max(QORE_HTTP_POOL_DEFAULT_MAX), waiting(0),
+   max_idle_ms(QORE_HTTP_POOL_DEFAULT_MAX_IDLE_MS), acquire_timeout_ms(0), stats_reqs(0), stats_reused(0),
+   stats_created(0), stats_evicted(0), stats_errors(0), stats_timeouts(0), wait_max(0), valid(true) {
+   const AbstractQoreNode* n = opts->getKeyValue("max_connections");
+   if (n) {
+      int64 v = n->getAsBigInt();
+      if (v < 1) {
+         xsink->raiseException("HTTP-CONNECTION-POOL-OPTION-ERROR", "the 'max_connections' option must be greater than zero; value given: "QLLD, v);
+         return;
+      }
+      max = (unsigned)v;
+   }
+
+   n = opts->getKeyValue("max_idle_time");
+   if (n)
+      max_idle_ms = getMsZeroInt(n);
+
+   n = opts->getKeyValue("acquire_timeout");
+   if (n)
+      acquire_timeout_ms = getMsZeroInt(n);
+
+   // check the HTTPClient options so that errors are reported here instead of for each request
+   QoreHttpClientObject* client = new QoreHttpClientObject;
+   client->setOptions(opts, xsink);
+   closeConnection(client, xsink);
+   if (*xsink)
+      return;
+
+   n = opts->getKeyValue("url");
+   if (n && n->getType() == NT_STRING) {
+      const char* url = reinterpret_cast<const QoreStringNode*>(n)->getBuffer();
+      const char* p = strstr(url, "://");
+      p = strchr(p ? p + 3 : url, '/');
+      if (p) {
+         base_prefix.assign(url, p - url);
+         base_path = p;
+      }
+      else
+         base_prefix = url;
+   }
+}
+
+void QoreHttpConnectionPool::destructor(ExceptionSink* xsink) {
+   http_pool_conn_list_t l;
+   {
+      AutoLocker al((QoreThreadLock*)this);
+      valid = false;
+      takeIdle(l);
+      if (waiting)
+         broadcast();
+   }
+
+   for (http_pool_conn_list_t::iterator i = l.begin(), e = l.end(); i != e; ++i)
+      closeConnection(i->client, xsink);
+
+   opts->deref(xsink);
+   opts = 0;
+}
+
+void QoreHttpConnectionPool::takeIdle(http_pool_conn_list_t& l) {
+   for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+      HttpPoolHost* h = i->second;
+      l.insert(l.end(), h->idle.begin(), h->idle.end());
+      h->evicted += h->idle.size();
+      stats_evicted += h->idle.size();
+      h->idle.clear();
+   }
+}
+
+void QoreHttpConnectionPool::clearIdle(ExceptionSink* xsink) {
+   http_pool_conn_list_t l;
+   {
+      AutoLocker al((QoreThreadLock*)this);
+      takeIdle(l);
+   }
+
+   for (http_pool_conn_list_t::iterator i = l.begin(), e = l.end(); i != e; ++i)
+      closeConnection(i->client, xsink);
+}
+
+int QoreHttpConnectionPool::getTarget(const char* path, std::string& key, std::string& url, std::string& rpath, std::string& user, std::string& pass, ExceptionSink* xsink) const {
+   if (path && strstr(path, "://"))
+      url = path;
+   else {
+      if (base_prefix.empty()) {
+         xsink->raiseException("HTTP-CONNECTION-POOL-URL-ERROR", "no 'url' option was given when the pool was created, so requests must give a complete URL (path given: '%s')", path ? path : "<none>");
+         return -1;
+      }
+      url = base_prefix;
+      const char* p = path && *path ? path : base_path.c_str();
+      if (*p != '/')
+         url += '/';
+      url += p;
+   }
+
+   QoreURL u(url.c_str());
+   if (!u.isValid() || !u.getHost() || u.getHost()->empty()) {
+      xsink->raiseException("HTTP-CONNECTION-POOL-URL-ERROR", "URL '%s' cannot be parsed", url.c_str());
+      return -1;
+   }
+
+   std::string scheme = u.getProtocol() ? u.getProtocol()->getBuffer() : "http";
+   for (unsigned i = 0; i < scheme.size(); ++i)
+      scheme[i] = tolower(scheme[i]);
+
+   std::string host = u.getHost()->getBuffer();
+   int port = u.getPort();
+   if (!port) {
+      // a URL consisting of a port number only refers to localhost as with HTTPClient
+      char* aux;
+      int val = strtol(host.c_str(), &aux, 10);
+      if (aux == host.c_str() + host.size()) {
+         host = "localhost";
+         port = val;
+      }
+      else if (scheme == "http")
+         port = 80;
+      else if (scheme == "https")
+         port = 443;
+   }
+
+   key = scheme;
+   key += "://";
+   key += host;
+   key += ':';
+   char buf[16];
+   sprintf(buf, "%d", port);
+   key += buf;
+
+   rpath = u.getPath() && !u.getPath()->empty() ? u.getPath()->getBuffer() : "/";
+   user = u.getUserName() ? u.getUserName()->getBuffer() : "";
+   pass = u.getPassword() ? u.getPassword()->getBuffer() : "";
+   return 0;
+}
+
+bool QoreHttpConnectionPool::checkIdle(QoreHttpClientObject* client) {
+   if (!client->isConnected() || !client->isOpen())
+      return false;
+
+   // a keep-alive connection with nothing outstanding must not be readable; if it is, then the server has closed the
+   // connection or has sent unexpected data
+   ExceptionSink xsink;
+   bool rc = client->isDataAvailable(&xsink, 0);
+   if (xsink) {
+      xsink.clear();
+      return false;
+   }
+   return !rc;
+}
+
+QoreHttpClientObject* QoreHttpConnectionPool::acquire(const std::string& key, const std::string& url, ExceptionSink* xsink) {
+   SafeLocker sl((QoreThreadLock*)this);
+
+   ++stats_reqs;
+   HttpPoolHost* h = getHost(key);
+   ++h->requests;
+
+   int64 wait_start = 0;
+   while (true) {
+      if (!valid) {
+         xsink->raiseException("HTTP-CONNECTION-POOL-ERROR", "the HTTPConnectionPool object has been deleted");
+         return 0;
+      }
+
+      // reuse the most recently used idle connection if possible
+      if (!h->idle.empty()) {
+         HttpPoolConnection c = h->idle.back();
+         h->idle.pop_back();
+         ++h->in_use;
+         bool expired = max_idle_ms && (q_clock_getmillis() - c.last_used) > max_idle_ms;
+
+         // check and close connections without holding the lock
+         sl.unlock();
+         bool ok = !expired && checkIdle(c.client);
+         if (!ok)
+            closeConnection(c.client, xsink);
+         sl.relock();
+
+         if (ok) {
+            ++h->reused;
+            ++stats_reused;
+            if (wait_start) {
+               int64 wait_total = q_clock_getmicros() - wait_start;
+               if (wait_total > wait_max)
+                  wait_max = wait_total;
+            }
+            return c.client;
+         }
+
+         --h->in_use;
+         ++h->evicted;
+         ++stats_evicted;
+         continue;
+      }
+
+      // create a new connection if the limit has not been reached
+      if (h->in_use < max) {
+         ++h->in_use;
+         ++h->created;
+         ++stats_created;
+         if (wait_start) {
+            int64 wait_total = q_clock_getmicros() - wait_start;
+            if (wait_total > wait_max)
+               wait_max = wait_total;
+         }
+         ReferenceHolder<QoreHashNode> o(opts->hashRefSelf(), xsink);
+         sl.unlock();
+
+         // the connection is established when the request is sent
+         QoreHttpClientObject* client = new QoreHttpClientObject;
+         if (client->setOptions(*o, xsink) || client->setURL(url.c_str(), xsink)) {
+            closeConnection(client, xsink);
+            sl.relock();
+            --h->in_use;
+            ++h->errors;
+            ++stats_errors;
+            if (waiting)
+               broadcast();
+            return 0;
+         }
+         return client;
+      }
+
+      // otherwise wait for a connection to be returned to the pool
+      int timeout_ms = 0;
+      if (!wait_start)
+         wait_start = q_clock_getmicros();
+      else if (acquire_timeout_ms) {
+         int64 elapsed_ms = (q_clock_getmicros() - wait_start) / 1000;
+         if (elapsed_ms >= acquire_timeout_ms) {
+            ++stats_timeouts;
+            xsink->raiseException("HTTP-CONNECTION-POOL-TIMEOUT", "timed out after waiting %d millisecond%s for a free connection to '%s' (%d connection%s in use)", acquire_timeout_ms, acquire_timeout_ms == 1 ? "" : "s", key.c_str(), h->in_use, h->in_use == 1 ? "" : "s");
+            return 0;
+         }
+         timeout_ms = acquire_timeout_ms - (int)elapsed_ms;
+      }
+      if (acquire_timeout_ms && !timeout_ms)
+         timeout_ms = acquire_timeout_ms;
+
+      ++waiting;
+      if (timeout_ms)
+         wait((QoreThreadLock*)this, timeout_ms);
+      else
+         wait((QoreThreadLock*)this);
+      --waiting;
+   }
+}
+
+void QoreHttpConnectionPool::release(const std::string& key, QoreHttpClientObject* client, bool reuse, bool error, ExceptionSink* xsink) {
+   // connections closed by the server (for example with "Connection: close") cannot be reused
+   if (reuse && !client->isConnected())
+      reuse = false;
+
+   {
+      AutoLocker al((QoreThreadLock*)this);
+      HttpPoolHost* h = hmap[key];
+      assert(h && h->in_use);
+      --h->in_use;
+      if (reuse && valid) {
+         h->idle.push_back(HttpPoolConnection(client, q_clock_getmillis()));
+         client = 0;
+      }
+      else if (error) {
+         ++h->errors;
+         ++stats_errors;
+      }
+      else {
+         ++h->evicted;
+         ++stats_evicted;
+      }
+
+      if (waiting)
+         broadcast();
+   }
+
+   if (client)
+      closeConnection(client, xsink);
+}
+
+QoreHashNode* QoreHttpConnectionPool::send(const char* meth, const char* path, const QoreHashNode* headers, const void* data, unsigned size, bool getbody, QoreHashNode* info, ExceptionSink* xsink) {
+   std::string key, url, rpath, user, pass;
+   if (getTarget(path, key, url, rpath, user, pass, xsink))
+      return 0;
+
+   QoreHttpClientObject* client = acquire(key, url, xsink);
+   if (!client)
+      return 0;
+
+   // credentials are set for each request, because connections are shared by all requests to the same server
+   if (user.empty())
+      client->clearUserPassword();
+   else
+      client->setUserPassword(user.c_str(), pass.c_str());
+
+   // an info hash is always used so that redirects can be detected; a redirected connection may be connected to a
+   // different server, so it cannot be returned to the pool
+   ReferenceHolder<QoreHashNode> tinfo(info ? 0 : new QoreHashNode, xsink);
+   if (!info)
+      info = *tinfo;
+
+   ReferenceHolder<QoreHashNode> rv(client->send(meth, rpath.c_str(), headers, data, size, getbody, info, xsink), xsink);
+   bool error = *xsink;
+   release(key, client, !error && !info->getKeyValue("redirect-1"), error, xsink);
+   return error ? 0 : rv.release();
+}
+
+QoreHashNode* QoreHttpConnectionPool::getStats() {
+   AutoLocker al((QoreThreadLock*)this);
+
+   int64 in_use = 0, idle = 0;
+   QoreHashNode* hosts = new QoreHashNode;
+   for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+      HttpPoolHost* h = i->second;
+      QoreHashNode* hh = new QoreHashNode;
+      hh->setKeyValue("in_use", new QoreBigIntNode(h->in_use), 0);
+      hh->setKeyValue("idle", new QoreBigIntNode(h->idle.size()), 0);
+      hh->setKeyValue("requests", new QoreBigIntNode(h->requests), 0);
+      hh->setKeyValue("reused", new QoreBigIntNode(h->reused), 0);
+      hh->setKeyValue("created", new QoreBigIntNode(h->created), 0);
+      hh->setKeyValue("evicted", new QoreBigIntNode(h->evicted), 0);
+      hh->setKeyValue("errors", new QoreBigIntNode(h->errors), 0);
+      hosts->setKeyValue(i->first.c_str(), hh, 0);
+      in_use += h->in_use;
+      idle += h->idle.size();
+   }
+
+   QoreHashNode* rv = new QoreHashNode;
+   rv->setKeyValue("max_connections", new QoreBigIntNode(max), 0);
+   rv->setKeyValue("max_idle_time", new QoreBigIntNode(max_idle_ms), 0);
+   rv->setKeyValue("acquire_timeout", new QoreBigIntNode(acquire_timeout_ms), 0);
+   rv->setKeyValue("in_use", new QoreBigIntNode(in_use), 0);
+   rv->setKeyValue("idle", new QoreBigIntNode(idle), 0);
+   rv->setKeyValue("waiting", new QoreBigIntNode(waiting), 0);
+   rv->setKeyValue("requests", new QoreBigIntNode(stats_reqs), 0);
+   rv->setKeyValue("reused", new QoreBigIntNode(stats_reused), 0);
+   rv->setKeyValue("created", new QoreBigIntNode(stats_created), 0);
+   rv->setKeyValue("evicted", new QoreBigIntNode(stats_evicted), 0);
+   rv->setKeyValue("errors", new QoreBigIntNode(stats_errors), 0);
+   rv->setKeyValue("timeouts", new QoreBigIntNode(stats_timeouts), 0);
+   rv->setKeyValue("wait_max", new QoreBigIntNode(wait_max), 0);
+   rv->setKeyValue("hosts", hosts, 0);
+   return rv;
+}
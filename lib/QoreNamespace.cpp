@@ -46,6 +46,9 @@
 
 // include files for default object classes
 #include <qore/intern/QC_Socket.h>
+#include <qore/intern/QC_SocketPoller.h>
+#include <qore/intern/QC_CompressionEncoder.h>
+#include <qore/intern/QC_CompressionDecoder.h>
 #include <qore/intern/QC_SSLCertificate.h>
 #include <qore/intern/QC_SSLPrivateKey.h>
 #include <qore/intern/QC_Program.h>
@@ -54,6 +57,7 @@
 #include <qore/intern/QC_GetOpt.h>
 #include <qore/intern/QC_FtpClient.h>
 #include <qore/intern/QC_HTTPClient.h>
+#include <qore/intern/QC_HTTPConnectionPool.h>
 #include <qore/intern/QC_TermIOS.h>
 #include <qore/intern/QC_TimeZone.h>
 #include <qore/intern/QC_TreeMap.h>
@@ -519,7 +523,7 @@ QoreNamespaceList::QoreNamespaceList(const QoreNamespaceList& old, int64 po, con
    //printd(5, "QoreNamespaceList::QoreNamespaceList(old: %p) this: %p po: %lld size: %ld\n", &old, this, po, nsmap.size());
    nsmap_t::iterator last = nsmap.begin();
    for (nsmap_t::const_iterator i = old.nsmap.begin(), e = old.nsmap.end(); i != e; ++i) {
-      if (!qore_ns_private::isPublic(*i->second))
+      if (!(po & PO_INTERN_CLONE) && !qore_ns_private::isPublic(*i->second))
          continue;
       QoreNamespace* ns = i->second->copy(po);
       ns->priv->parent = &parent;
@@ -762,18 +766,23 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
    qns.addSystemClass(initTimeZoneClass(qns));
    qns.addSystemClass(initSSLCertificateClass(qns));
    qns.addSystemClass(initSSLPrivateKeyClass(qns));
-   qns.addSystemClass(initSocketClass(qns));
-   qns.addSystemClass(initProgramClass(qns));
 
+   // file classes must be initialized before the Socket class
    qns.addSystemClass(initTermIOSClass(qns));
    qns.addSystemClass(initReadOnlyFileClass(qns));
    qns.addSystemClass(initFileClass(qns));
+
+   qns.addSystemClass(initSocketClass(qns));
+   qns.addSystemClass(initSocketPollerClass(qns));
+   qns.addSystemClass(initProgramClass(qns));
+
    qns.addSystemClass(initDirClass(qns));
    qns.addSystemClass(initGetOptClass(qns));
    qns.addSystemClass(initFtpClientClass(qns));
 
    // add HTTPClient namespace
    qns.addSystemClass(initHTTPClientClass(qns));
+   qns.addSystemClass(initHTTPConnectionPoolClass(qns));
 
    qns.addSystemClass(initAbstractIteratorClass(qns));
    qns.addSystemClass(initAbstractQuantifiedIteratorClass(qns));
@@ -802,6 +811,8 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
    qns.addSystemClass(initSingleValueIteratorClass(qns));
    qns.addSystemClass(initRangeIteratorClass(qns));
    qns.addSystemClass(initTreeMapClass(qns));
+   qns.addSystemClass(initCompressionEncoderClass(qns));
+   qns.addSystemClass(initCompressionDecoderClass(qns));
 
 #ifdef DEBUG_TESTS
    { // tests
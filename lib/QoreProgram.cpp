@@ -307,6 +307,93 @@ void qore_program_private_base::setParent(QoreProgram* p_pgm, int64 n_parse_opti
       dmap[i->first] = i->second ? i->second->refSelf() : 0;
 }
 
+// maps the global variables of a namespace tree in a program clone's source to the copies in the clone; global
+// variables in the source are assigned a slot in the clone variable table the first time the source is cloned
+// must be called with the source program's plock held
+static void get_clone_vars(const qore_ns_private& src, const qore_ns_private& ns, clone_var_vec_t& cv, int& slots) {
+   for (map_var_t::const_iterator i = src.var_list.vmap.begin(), e = src.var_list.vmap.end(); i != e; ++i) {
+      // imported variables already refer to the same target in the clone
+      if (i->second->isRef())
+         continue;
+      map_var_t::const_iterator ci = ns.var_list.vmap.find(i->first);
+      if (ci == ns.var_list.vmap.end())
+         continue;
+
+      int slot = i->second->getCloneSlot();
+      if (slot < 0) {
+         slot = slots++;
+         i->second->setCloneSlot(slot);
+      }
+      if ((unsigned)slot >= cv.size())
+         cv.resize(slot + 1, clone_var_vec_t::value_type(0, 0));
+      cv[slot] = clone_var_vec_t::value_type(i->second, ci->second);
+   }
+
+   for (nsmap_t::const_iterator i = src.nsl.nsmap.begin(), e = src.nsl.nsmap.end(); i != e; ++i) {
+      nsmap_t::const_iterator ci = ns.nsl.nsmap.find(i->first);
+      if (ci != ns.nsl.nsmap.end())
+         get_clone_vars(*qore_ns_private::get(*i->second), *qore_ns_private::get(*ci->second), cv, slots);
+   }
+}
+
+void qore_program_private_base::setClone(QoreProgram* src_pgm) {
+   qore_program_private_base* src = src_pgm->priv;
+
+   // the code is always executed from the original program, so clones of clones refer to the original source
+   clone_src = src->clone_src ? src->clone_src : src_pgm;
+   clone_src->ref();
+   {
+      AutoLocker al(clone_src->priv->plock);
+      ++clone_src->priv->clone_count;
+   }
+
+   // clones get their own thread-local data
+   base_object = true;
+   thread_local_storage = new qpgm_thread_local_storage_t;
+   thread_local_storage->set(new QoreHashNode);
+
+   {
+      // make sure no parsing is running in the source while we copy its state
+      ProgramRuntimeParseAccessHelper rah(0, src_pgm);
+
+      TZ = src_pgm->currentTZ();
+      pwo = src->pwo;
+      // top-level code is always executed from the source program, so clones cannot add new top-level statements
+      pwo.parse_options |= PO_NO_TOP_LEVEL_STATEMENTS;
+      po_locked = src->po_locked;
+      po_allow_restrict = src->po_allow_restrict;
+      dom = src->dom;
+      exec_class = src->exec_class;
+      exec_class_name = src->exec_class_name;
+      script_dir = src->script_dir;
+      script_path = src->script_path;
+      script_name = src->script_name;
+      include_path = src->include_path;
+
+      // copy all namespaces; functions and classes share their code with the source, global variables are
+      // copied with their current values
+      RootNS = qore_root_ns_private::copy(*src->RootNS, PO_INTERN_CLONE);
+
+      // map the source program's global variables to the copies in this program
+      {
+         AutoLocker al(clone_src->priv->plock);
+         get_clone_vars(*qore_root_ns_private::get(*clone_src->priv->RootNS), *qore_root_ns_private::get(*RootNS), clone_vars, clone_src->priv->clone_slots);
+      }
+
+      src->featureList.populate(&featureList);
+      src->userFeatureList.populate(&userFeatureList);
+
+      // top-level local variables are instantiated per thread by each program
+      const LVList* lvl = src->sb.getLVList();
+      if (lvl)
+         sb.assignLocalVars(lvl);
+
+      for (dmap_t::const_iterator i = src->dmap.begin(), e = src->dmap.end(); i != e; ++i)
+         dmap[i->first] = i->second ? i->second->refSelf() : 0;
+   }
+   QoreNS = RootNS->rootGetQoreNamespace();
+}
+
 void qore_program_private::internParseRollback() {
    // delete pending changes to namespaces
    qore_root_ns_private::parseRollback(*RootNS);
@@ -327,7 +414,8 @@ void qore_program_private::waitForTerminationAndClear(ExceptionSink* xsink) {
          AutoLocker al(plock);
          // wait for all threads to terminate
          waitForAllThreadsToTerminateIntern();
-         if (!ptid) {
+         // the code and data of a program with clones are cleared when the last clone releases it
+         if (!ptid && !clone_count) {
             l = new QoreListNode;
             qore_root_ns_private::clearConstants(*RootNS, **l);
 	    // mark the program so that only code from this thread can run during data destruction
@@ -663,6 +751,18 @@ void qore_program_private::del(ExceptionSink* xsink) {
    // method call can be repeated
    sb.del();
    //printd(5, "QoreProgram::~QoreProgram() this: %p deleting root ns %p\n", this, RootNS);
+
+   // release the source program for clones
+   if (clone_src) {
+      clone_vars.clear();
+      {
+         AutoLocker al(clone_src->priv->plock);
+         assert(clone_src->priv->clone_count);
+         --clone_src->priv->clone_count;
+      }
+      clone_src->deref(xsink);
+      clone_src = 0;
+   }
 }
 
 QoreProgram::~QoreProgram() {
@@ -684,6 +784,19 @@ QoreProgram::QoreProgram(QoreProgram* pgm, int64 po, bool ec, const char* ecn) :
       priv->exec_class_name = ecn;
 }
 
+// setup program clone
+QoreProgram::QoreProgram(const QoreProgram& src, bool) : priv(new qore_program_private(this, src)) {
+}
+
+QoreProgram* QoreProgram::clone(ExceptionSink* xsink) {
+   // make sure that the source program is still valid
+   ProgramRuntimeParseAccessHelper rah(xsink, this);
+   if (*xsink)
+      return 0;
+
+   return new QoreProgram(*this, true);
+}
+
 QoreThreadLock* QoreProgram::getParseLock() {
    return &priv->plock;
 }
@@ -926,7 +1039,8 @@ AbstractQoreNode* QoreProgram::runTopLevel(ExceptionSink* xsink) {
    ProgramThreadCountContextHelper tch(xsink, this, true);
    if (*xsink)
       return 0;
-   return priv->sb.exec(xsink).takeNode();
+   // program clones execute the top-level code of the source program
+   return (priv->clone_src ? priv->clone_src->priv->sb : priv->sb).exec(xsink).takeNode();
 }
 
 AbstractQoreNode* QoreProgram::callFunction(const char* name, const QoreListNode* args, ExceptionSink* xsink) {
@@ -48,22 +48,35 @@ void qore_queue_private::destructor(ExceptionSink* xsink) {
 
    clearIntern(xsink);
    len = Queue_Deleted;
+
+   // wake up any threads selecting on the queue so they can detect that it has been deleted
+   signalWaitersIntern();
 }
 
 void qore_queue_private::clearIntern(ExceptionSink* xsink) {
-   while (head) {
-      printd(5, "qore_queue_private::clearIntern() this: %p deleting %p (node %p type %s)\n", this, head, head->node, get_node_type(head->node));
-      QoreQueueNode* w = head->next;
-      head->del(xsink);
-      head = w;
+   for (int i = 0; i < len; ++i) {
+      AbstractQoreNode* n = buf[pos(i)];
+      printd(5, "qore_queue_private::clearIntern() this: %p deleting node %p type %s\n", this, n, get_type_name(n));
+      if (n)
+         n->deref(xsink);
    }
-   head = 0;
-   tail = 0;
+   first = 0;
+}
+
+void qore_queue_private::resizeIntern(int ncap) {
+   assert(ncap >= len);
+   AbstractQoreNode** nb = new AbstractQoreNode*[ncap];
+   for (int i = 0; i < len; ++i)
+      nb[i] = buf[pos(i)];
+   delete [] buf;
+   buf = nb;
+   cap = ncap;
+   first = 0;
 }
 
 int qore_queue_private::waitReadIntern(ExceptionSink *xsink, int timeout_ms) {
    // if there is no data, then wait for condition variable
-   while (!head) {
+   while (len <= 0) {
       ++read_waiting;
       int rc = timeout_ms ? read_cond.wait(l, timeout_ms) : read_cond.wait(l);
       --read_waiting;
@@ -114,46 +127,37 @@ int qore_queue_private::waitWriteIntern(ExceptionSink *xsink, int timeout_ms) {
 }
 
 void qore_queue_private::pushNode(AbstractQoreNode* v) {
-   if (!head) {
-      head = new QoreQueueNode(v, 0, 0);
-      tail = head;
-   }
-   else {
-      QoreQueueNode* qn = new QoreQueueNode(v, tail, 0);
-      tail->next = qn;
-      tail = qn;
-   }
+   reserveIntern();
+   buf[pos(len)] = v;
    ++len;
 
-   //printd(5, "qore_queue_private::pushNode(%p '%s') this: %p head: %p (%p) tail: %p (%p) read_waiting: %d len: %d\n", v, get_type_name(v), this, head, head->node, tail, tail->node, read_waiting, len);
+   //printd(5, "qore_queue_private::pushNode(%p '%s') this: %p read_waiting: %d len: %d\n", v, get_type_name(v), this, read_waiting, len);
 }
 
 void qore_queue_private::pushIntern(AbstractQoreNode* v) {
    pushNode(v);
-   //printd(5, "qore_queue_private::push_internal(%p) this=%p head=%p (%p) tail=%p (%p) waiting=%d len=%d\n", v, this, head, head->node, tail, tail->node, waiting, len);
+   //printd(5, "qore_queue_private::push_internal(%p) this=%p len=%d\n", v, this, len);
 
    // signal waiting thread to wakeup and process event
    if (read_waiting)
       read_cond.signal();
+   if (!waiters.empty())
+      signalWaitersIntern();
 }
 
 void qore_queue_private::insertIntern(AbstractQoreNode* v) {
-   if (!head) {
-      head = new QoreQueueNode(v, 0, 0);
-      tail = head;
-   }
-   else {
-      QoreQueueNode* qn = new QoreQueueNode(v, 0, head);
-      head->prev = qn;
-      head = qn;
-   }
-   len++;
+   reserveIntern();
+   first = (first - 1) & (cap - 1);
+   buf[first] = v;
+   ++len;
 
-   //printd(5, "qore_queue_private::insertIntern(%p) this=%p head=%p (%p) tail=%p (%p) waiting=%d len=%d\n", v, this, head, head->node, tail, tail->node, waiting, len);
+   //printd(5, "qore_queue_private::insertIntern(%p) this=%p len=%d\n", v, this, len);
 
    // signal waiting thread to wakeup and process event
    if (read_waiting)
       read_cond.signal();
+   if (!waiters.empty())
+      signalWaitersIntern();
 }
 
 void qore_queue_private::pushAndTakeRef(AbstractQoreNode* n) {
@@ -201,10 +205,10 @@ void qore_queue_private::insert(ExceptionSink* xsink, const AbstractQoreNode* n,
 }
 
 AbstractQoreNode* qore_queue_private::shift(ExceptionSink* xsink, int timeout_ms, bool* to) {
-   SafeLocker sl(&l);
+   AutoLocker al(&l);
 
 #ifdef DEBUG
-   //if (!head) printd(5, "qore_queue_private::shift(timeout_ms=%d) WAITING this=%p head=%p tail=%p waiting=%d len=%d\n", timeout_ms, this, head, tail, waiting, len);
+   //if (len <= 0) printd(5, "qore_queue_private::shift(timeout_ms=%d) WAITING this=%p read_waiting=%d len=%d\n", timeout_ms, this, read_waiting, len);
 #endif
 
    {
@@ -215,25 +219,89 @@ AbstractQoreNode* qore_queue_private::shift(ExceptionSink* xsink, int timeout_ms
          return 0;
    }
 
-   //printd(5, "qore_queue_private::shift() GOT DATA this: %p head: %p (rv: %p '%s') tail: %p (%p) write_waiting: %d len: %d\n", this, head, head->node, get_type_name(head->node), tail, tail->node, write_waiting, len);
-
-   QoreQueueNode* n = head;
-   head = head->next;
-   if (!head)
-      tail = 0;
-   else
-      head->prev = 0;
+   AbstractQoreNode* rv = shiftNode();
+   //printd(5, "qore_queue_private::shift() GOT DATA this: %p rv: %p '%s' write_waiting: %d len: %d\n", this, rv, get_type_name(rv), write_waiting, len);
 
-   len--;
    if (write_waiting)
       write_cond.signal();
 
-   sl.unlock();
-   return n->takeAndDel();
+   return rv;
+}
+
+void qore_queue_private::pushList(ExceptionSink* xsink, const QoreListNode* lst, int timeout_ms, bool* to) {
+   if (to)
+      *to = false;
+
+   int64 end = timeout_ms > 0 ? q_clock_getmillis() + timeout_ms : 0;
+
+   AutoLocker al(&l);
+   if (len == Queue_Deleted)
+      return;
+
+   qore_size_t i = 0, size = lst->size();
+   while (i < size) {
+      int tms = timeout_ms;
+      if (end && i) {
+         int64 left = end - q_clock_getmillis();
+         tms = left > 0 ? (int)left : 1;
+      }
+      int rc = waitWriteIntern(xsink, tms);
+      if (rc) {
+         if (to)
+            *to = rc == QW_TIMEOUT ? true : false;
+         return;
+      }
+
+      // add as many elements as there is room for
+      int n = 0;
+      do {
+         const AbstractQoreNode* v = lst->retrieve_entry(i++);
+         pushNode(v ? v->refSelf() : 0);
+         ++n;
+      } while (i < size && (max <= 0 || len < max));
+
+      // wake up as many readers as there are new elements with a single call
+      if (read_waiting) {
+         if (n > 1)
+            read_cond.broadcast();
+         else
+            read_cond.signal();
+      }
+      if (!waiters.empty())
+         signalWaitersIntern();
+   }
+}
+
+QoreListNode* qore_queue_private::shiftList(ExceptionSink* xsink, int n, int timeout_ms, bool* to) {
+   AutoLocker al(&l);
+
+   {
+      int rc = waitReadIntern(xsink, timeout_ms);
+      if (to)
+         *to = rc == QW_TIMEOUT ? true : false;
+      if (rc)
+         return 0;
+   }
+
+   if (n <= 0 || n > len)
+      n = len;
+
+   QoreListNode* rv = new QoreListNode;
+   for (int i = 0; i < n; ++i)
+      rv->push(shiftNode());
+
+   if (write_waiting) {
+      if (n > 1)
+         write_cond.broadcast();
+      else
+         write_cond.signal();
+   }
+
+   return rv;
 }
 
 AbstractQoreNode* qore_queue_private::pop(ExceptionSink* xsink, int timeout_ms, bool* to) {
-   SafeLocker sl(&l);
+   AutoLocker al(&l);
 
    {
       int rc = waitReadIntern(xsink, timeout_ms);
@@ -243,31 +311,29 @@ AbstractQoreNode* qore_queue_private::pop(ExceptionSink* xsink, int timeout_ms,
          return 0;
    }
    
-   QoreQueueNode* n = tail;
-   tail = tail->prev;
-   if (!tail)
-      head = 0;
-   else
-      tail->next = 0;
-   
-   len--;
+   AbstractQoreNode* rv = popNode();
    if (write_waiting)
       write_cond.signal();
 
-   sl.unlock();
-   return n->takeAndDel();
+   return rv;
 }
 
 void qore_queue_private::clear(ExceptionSink* xsink) {
    AutoLocker al(&l);
    if (read_waiting) {
       // the queue must be empty
-      assert(!head);
+      assert(len <= 0);
       return;
    }
 
    clearIntern(xsink);
    len = 0;
+   // release any memory allocated for a burst of data
+   if (cap > min_cap) {
+      delete [] buf;
+      cap = min_cap;
+      buf = new AbstractQoreNode*[cap];
+   }
 
    if (write_waiting)
       write_cond.signal();
@@ -304,6 +370,14 @@ AbstractQoreNode* QoreQueue::shift(ExceptionSink* xsink, int timeout_ms, bool* t
    return priv->shift(xsink, timeout_ms, to);
 }
 
+void QoreQueue::pushList(ExceptionSink* xsink, const QoreListNode* l, int timeout_ms, bool* to) {
+   priv->pushList(xsink, l, timeout_ms, to);
+}
+
+QoreListNode* QoreQueue::shiftList(ExceptionSink* xsink, int max, int timeout_ms, bool* to) {
+   return priv->shiftList(xsink, max, timeout_ms, to);
+}
+
 AbstractQoreNode* QoreQueue::pop(ExceptionSink* xsink, int timeout_ms, bool* to) {
    return priv->pop(xsink, timeout_ms, to);
 }
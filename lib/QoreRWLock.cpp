@@ -70,3 +70,11 @@ void QoreVarRWLock::rdlock() {
 int QoreVarRWLock::tryrdlock() {
    return priv->tryrdlock();
 }
+
+unsigned QoreVarRWLock::readSeqBegin() const {
+   return priv->readSeqBegin();
+}
+
+bool QoreVarRWLock::readSeqRetry(unsigned s) const {
+   return priv->readSeqRetry(s);
+}
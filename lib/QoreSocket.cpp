@@ -414,6 +414,10 @@ int SSLSocketHelper::write(const char* mname, const void* buf, int size, int tim
    return doSSLRW(mname, (void*)buf, size, timeout_ms, false, xsink);
 }
 
+bool SSLSocketHelper::pending() const {
+   return ssl && SSL_pending(ssl) > 0;
+}
+
 const char* SSLSocketHelper::getCipherName() const {
    return SSL_get_cipher_name(ssl);
 }
@@ -47,6 +47,29 @@ QoreSocketObject::~QoreSocketObject() {
    delete priv;
 }
 
+bool my_socket_priv::tryIsDataBuffered(QoreSocketObject& sock) {
+   if (sock.priv->m.trylock())
+      return false;
+   bool rc = qore_socket_private::get(*sock.priv->socket)->isDataBuffered();
+   sock.priv->m.unlock();
+   return rc;
+}
+
+int64 my_socket_priv::sendFile(QoreSocketObject& sock, int fd, int64 offset, int64 len, int timeout_ms, ExceptionSink* xsink) {
+   AutoLocker al(sock.priv->m);
+   return qore_socket_private::get(*sock.priv->socket)->sendFile(xsink, "sendFile", fd, offset, len, timeout_ms);
+}
+
+void my_socket_priv::setReadBufferSize(QoreSocketObject& sock, qore_size_t size) {
+   AutoLocker al(sock.priv->m);
+   qore_socket_private::get(*sock.priv->socket)->setReadBufferSize(size);
+}
+
+qore_size_t my_socket_priv::getReadBufferSize(QoreSocketObject& sock) {
+   AutoLocker al(sock.priv->m);
+   return qore_socket_private::get(*sock.priv->socket)->getReadBufferSize();
+}
+
 void QoreSocketObject::deref(ExceptionSink* xsink) {
    if (ROdereference()) {
       priv->socket->cleanup(xsink);
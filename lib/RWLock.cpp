@@ -36,19 +36,225 @@
 #include <qore/intern/RWLock.h>
 
 #include <assert.h>
+#include <unistd.h>
+
+// returns the number of reader stripes for reader-biased locks: the number of CPUs rounded up to a power of 2
+static unsigned q_rwlock_stripes() {
+   static unsigned stripes = 0;
+   if (!stripes) {
+      unsigned n = 4;
+#ifdef _SC_NPROCESSORS_ONLN
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      while ((long)n < cpus && n < QORE_RWLOCK_MAX_STRIPES)
+         n <<= 1;
+#endif
+      stripes = n;
+   }
+   return stripes;
+}
 
-RWLock::RWLock(bool p) : readRequests(0), prefer_writers(p), num_readers(0) {
+RWLock::RWLock(bool p, bool reader_biased) : readRequests(0), prefer_writers(p), num_readers(0), stripes(0), num_stripes(0), write_pending(false), pending_vl(0) {
+   if (reader_biased) {
+      num_stripes = q_rwlock_stripes();
+      stripes = new RWLockStripe[num_stripes];
+   }
 }
 
-#ifdef DEBUG
 RWLock::~RWLock() {
    assert(tmap.empty());
    assert(cmap.empty());
+   delete [] stripes;
 }
-#endif
 
 int RWLock::numReaders() {
-   return num_readers;
+   if (!stripes)
+      return num_readers;
+
+   int rc = 0;
+   for (unsigned i = 0; i < num_stripes; ++i) {
+      AutoLocker al(stripes[i].m);
+      rc += stripes[i].num_readers;
+   }
+   return rc;
+}
+
+bool RWLock::readLockOwnerBiased() const {
+   int mtid = gettid();
+   RWLockStripe& s = getStripe(mtid);
+   AutoLocker al(s.m);
+   return s.tmap.find(mtid) != s.tmap.end();
+}
+
+void RWLock::get_readers_intern(vlock_map_t& rmap) const {
+   for (unsigned i = 0; i < num_stripes; ++i) {
+      AutoLocker al(stripes[i].m);
+      rmap.insert(stripes[i].vmap.begin(), stripes[i].vmap.end());
+   }
+}
+
+void RWLock::mark_stripe_read_lock_intern(RWLockStripe& s, int mtid, VLock* nvl) {
+   ++s.num_readers;
+
+   tid_map_t::iterator i = s.tmap.find(mtid);
+   if (i != s.tmap.end()) {
+      ++(i->second);
+      return;
+   }
+
+   s.tmap[mtid] = 1;
+   s.vmap[mtid] = nvl;
+   // now register that we have grabbed this lock with the thread list
+   nvl->push((AbstractSmartLock*)this);
+   // register the thread resource
+   set_thread_resource((AbstractThreadResource*)this);
+}
+
+int RWLock::release_stripe_read_lock_intern(RWLockStripe& s, tid_map_t::iterator i) {
+   --s.num_readers;
+   if (--(i->second))
+      return -1;
+
+   vlock_map_t::iterator vi = s.vmap.find(i->first);
+   vi->second->pop((AbstractSmartLock*)this);
+   s.tmap.erase(i);
+   s.vmap.erase(vi);
+   return 0;
+}
+
+int RWLock::try_stripe_read_lock_intern(int mtid, VLock* nvl) {
+   RWLockStripe& s = getStripe(mtid);
+   AutoLocker al(s.m);
+   // a pending writer blocks new readers, but threads already holding the read lock can acquire it recursively
+   if (write_pending && s.tmap.find(mtid) == s.tmap.end())
+      return -1;
+
+   mark_stripe_read_lock_intern(s, mtid, nvl);
+   return 0;
+}
+
+int RWLock::grab_biased_read_lock_intern(int mtid, VLock* nvl, int64 timeout_ms, ExceptionSink* xsink) {
+   while (tid != Lock_Deleted && (tid >= 0 || write_pending)) {
+      if (!try_stripe_read_lock_intern(mtid, nvl))
+         return 0;
+
+      ++readRequests;
+      int rc = nvl->waitOn((AbstractSmartLock*)this, &read, tid >= 0 ? vl : pending_vl, xsink, timeout_ms);
+      --readRequests;
+      if (rc)
+         return -1;
+   }
+
+   if (tid == Lock_Deleted) {
+      xsink->raiseException("LOCK-ERROR", "The %s object has been deleted in another thread", getName());
+      return -1;
+   }
+
+   RWLockStripe& s = getStripe(mtid);
+   AutoLocker al(s.m);
+   mark_stripe_read_lock_intern(s, mtid, nvl);
+   return 0;
+}
+
+void RWLock::cancel_write_pending_intern() {
+   write_pending = false;
+   pending_vl = 0;
+   if (readRequests)
+      read.broadcast();
+   if (waiting)
+      asl_cond.signal();
+}
+
+int RWLock::grab_biased_write_lock_intern(int mtid, VLock* nvl, ExceptionSink* xsink, int64 timeout_ms) {
+   // wait for any other writer to release the lock or to finish waiting for readers
+   while (tid != Lock_Deleted && (tid >= 0 || write_pending)) {
+      ++waiting;
+      int rc = nvl->waitOn((AbstractSmartLock*)this, tid >= 0 ? vl : pending_vl, xsink, timeout_ms);
+      --waiting;
+      if (rc)
+         return -1;
+   }
+
+   // block new readers and wait for the current readers to drain
+   write_pending = true;
+   pending_vl = nvl;
+   while (tid != Lock_Deleted) {
+      vlock_map_t rmap;
+      get_readers_intern(rmap);
+      if (rmap.empty()) {
+         pending_vl = 0;
+         return 0;
+      }
+
+      ++waiting;
+      int rc = nvl->waitOn((AbstractSmartLock*)this, rmap, xsink, timeout_ms);
+      --waiting;
+      if (rc) {
+         if (tid != Lock_Deleted)
+            cancel_write_pending_intern();
+         return -1;
+      }
+   }
+
+   xsink->raiseException("LOCK-ERROR", "The %s object has been deleted in another thread", getName());
+   return -1;
+}
+
+int RWLock::release_biased_read_lock_intern(int mtid, ExceptionSink* xsink, bool fast) {
+   RWLockStripe& s = getStripe(mtid);
+   SafeLocker sl(&s.m);
+   // a writer waiting for readers to drain must be woken up, which requires asl_lock
+   if (fast && write_pending)
+      return 1;
+
+   tid_map_t::iterator i = s.tmap.find(mtid);
+   if (i == s.tmap.end()) {
+      sl.unlock();
+      xsink->raiseException("LOCK-ERROR", "TID %d called %s::readUnlock() while not holding the read lock", mtid, getName());
+      return -1;
+   }
+
+   if (!release_stripe_read_lock_intern(s, i))
+      remove_thread_resource((AbstractThreadResource*)this);
+   return 0;
+}
+
+int RWLock::extern_biased_read_wait_intern(int mtid, QoreCondition* cond, ExceptionSink* xsink, int64 timeout_ms) {
+   RWLockStripe& s = getStripe(mtid);
+   VLock* nvl;
+   {
+      AutoLocker al(s.m);
+      tid_map_t::iterator i = s.tmap.find(mtid);
+      if (i == s.tmap.end()) {
+         xsink->raiseException("LOCK-ERROR", "TID %d trying to wait on %s object while not holding either the read or write lock", mtid, getName());
+         return -1;
+      }
+
+      nvl = s.vmap[mtid];
+      if (!release_stripe_read_lock_intern(s, i))
+         remove_thread_resource((AbstractThreadResource*)this);
+   }
+   if (write_pending && waiting)
+      asl_cond.broadcast();
+
+   // insert into cond map
+   cond_map_t::iterator ci = cmap.find(cond);
+   if (ci == cmap.end())
+      ci = cmap.insert(std::make_pair(cond, 1)).first;
+   else
+      ++(ci->second);
+
+   // wait for condition
+   int rc = timeout_ms ? cond->wait(&asl_lock, timeout_ms) : cond->wait(&asl_lock);
+
+   // decrement cond count and delete from map if 0
+   if (!--(ci->second))
+      cmap.erase(ci);
+
+   // reacquire the lock
+   if (grab_biased_read_lock_intern(mtid, nvl, 0, xsink))
+      return -1;
+
+   return rc;
 }
 
 int RWLock::externWaitImpl(int mtid, QoreCondition *cond, ExceptionSink *xsink, int64 timeout_ms) {
@@ -87,6 +293,9 @@ int RWLock::externWaitImpl(int mtid, QoreCondition *cond, ExceptionSink *xsink,
       return -1;
    }
 
+   if (stripes)
+      return extern_biased_read_wait_intern(mtid, cond, xsink, timeout_ms);
+
    tid_map_t::iterator i = tmap.find(mtid);
    if (i == tmap.end()) {
       xsink->raiseException("LOCK-ERROR", "TID %d trying to wait on %s object while not holding either the read or write lock", mtid, getName());
@@ -128,6 +337,9 @@ int RWLock::grabImpl(int mtid, VLock *nvl, ExceptionSink *xsink, int64 timeout_m
       xsink->raiseException("LOCK-ERROR", "TID %d tried to grab the write lock twice", tid);
       return -1;
    }
+   if (stripes)
+      return grab_biased_write_lock_intern(mtid, nvl, xsink, timeout_ms);
+
    while (tid >= 0 || (tid == Lock_Unlocked && num_readers)) {
       ++waiting;
       int rc;
@@ -155,6 +367,18 @@ void RWLock::signalAllImpl() {
 }
 
 void RWLock::signalImpl() {
+   if (stripes) {
+      // the write lock has been released: let new readers in and wake up one writer, which will block new readers
+      // again while it waits for the current readers to drain
+      if (tid == Lock_Unlocked && !pending_vl)
+         write_pending = false;
+      if (readRequests)
+         read.broadcast();
+      if (waiting)
+         asl_cond.signal();
+      return;
+   }
+
    if (prefer_writers) {
       if (waiting)
 	 asl_cond.signal();
@@ -178,6 +402,26 @@ void RWLock::destructorImpl(ExceptionSink *xsink) {
          i->first->broadcast();
    }
 
+   if (stripes) {
+      // force all readers to the slow path, where they will see that the lock has been deleted
+      write_pending = true;
+      pending_vl = 0;
+      for (unsigned si = 0; si < num_stripes; ++si) {
+         RWLockStripe& s = stripes[si];
+         AutoLocker al(s.m);
+         for (vlock_map_t::iterator vi = s.vmap.begin(), ve = s.vmap.end(); vi != ve; ++vi)
+            vi->second->pop((AbstractSmartLock*)this);
+         s.vmap.clear();
+         s.tmap.clear();
+         s.num_readers = 0;
+      }
+      if (waiting)
+         asl_cond.broadcast();
+      if (readRequests)
+         read.broadcast();
+      return;
+   }
+
    if (num_readers)
       asl_cond.broadcast();
 
@@ -209,6 +453,21 @@ int RWLock::cleanup_read_lock_intern(tid_map_t::iterator i) {
 
 // internal use only - releases read and write locks
 int RWLock::releaseImpl() {
+   if (stripes) {
+      int mtid = gettid();
+      if (tid == mtid)
+         return 0;
+
+      RWLockStripe& s = getStripe(mtid);
+      AutoLocker al(s.m);
+      tid_map_t::iterator ti = s.tmap.find(mtid);
+      assert(ti != s.tmap.end());
+      release_stripe_read_lock_intern(s, ti);
+      if (write_pending && waiting)
+         asl_cond.broadcast();
+      return -1;
+   }
+
    if (num_readers) {
       // signal writers if any are waiting
       if (!--num_readers && waiting)
@@ -231,6 +490,27 @@ int RWLock::releaseImpl() {
 
 // thread exited holding the lock: remove whatever lock was locked
 void RWLock::cleanupImpl() {
+   if (stripes && tid != gettid()) {
+      int mtid = gettid();
+      RWLockStripe& s = getStripe(mtid);
+      AutoLocker al(s.m);
+      vlock_map_t::iterator vi = s.vmap.find(mtid);
+      // the lock may have been deleted in the meantime
+      if (vi == s.vmap.end())
+         return;
+
+      vi->second->pop(this);
+      s.vmap.erase(vi);
+      tid_map_t::iterator ti = s.tmap.find(mtid);
+      assert(ti != s.tmap.end());
+      s.num_readers -= ti->second;
+      s.tmap.erase(ti);
+      // wake up a writer waiting for readers to drain
+      if (write_pending && waiting)
+         asl_cond.broadcast();
+      return;
+   }
+
    // if it was a read lock
    if (num_readers) {
       int mtid = gettid();
@@ -293,6 +573,19 @@ int RWLock::releaseImpl(ExceptionSink *xsink) {
 }
 
 int RWLock::tryGrabImpl(int mtid, class VLock *nvl) {
+   if (stripes) {
+      if (tid != Lock_Unlocked || write_pending)
+         return -1;
+
+      // block new readers before checking for existing readers
+      write_pending = true;
+      if (numReaders()) {
+         cancel_write_pending_intern();
+         return -1;
+      }
+      return 0;
+   }
+
    if (tid != Lock_Unlocked || num_readers)
       return -1;
 
@@ -324,6 +617,11 @@ void RWLock::mark_read_lock_intern(int mtid, VLock *nvl) {
 int RWLock::readLock(ExceptionSink *xsink, int64 timeout_ms) {
    int mtid = gettid();
    VLock *nvl = getVLock();
+   // reader-biased fast path: only the stripe lock is acquired if no writer is pending
+   // (lock profiling requires asl_lock, so the fast path is not used while profiling is enabled)
+   if (stripes && !qore_lock_profiling && !try_stripe_read_lock_intern(mtid, nvl))
+      return 0;
+
    SafeLocker sl(&asl_lock);
 
    if (tid == mtid) {
@@ -331,7 +629,11 @@ int RWLock::readLock(ExceptionSink *xsink, int64 timeout_ms) {
       return -1;
    }
 
-   return grab_read_lock_intern(mtid, nvl, timeout_ms, xsink);
+   QoreLockProfileHelper lph(this, nvl);
+   int rc = stripes ? grab_biased_read_lock_intern(mtid, nvl, timeout_ms, xsink) : grab_read_lock_intern(mtid, nvl, timeout_ms, xsink);
+   if (!rc)
+      lph.acquired();
+   return rc;
 }
 
 // assumes the write lock is not grabbed by this thread
@@ -380,6 +682,13 @@ void RWLock::release_read_lock_intern(tid_map_t::iterator i) {
 
 int RWLock::readUnlock(ExceptionSink* xsink) {
    int mtid = gettid();
+   // reader-biased fast path: asl_lock is only needed to wake up a writer waiting for readers to drain
+   if (stripes && tid != mtid) {
+      int rc = release_biased_read_lock_intern(mtid, xsink, true);
+      if (rc <= 0)
+         return rc;
+   }
+
    AutoLocker al(&asl_lock);
    if (tid == mtid) {
       xsink->raiseException("LOCK-ERROR", "TID %d called %s::readUnlock() while holding the write lock", mtid, getName());
@@ -391,6 +700,14 @@ int RWLock::readUnlock(ExceptionSink* xsink) {
       return -1;
    }
 
+   if (stripes) {
+      if (release_biased_read_lock_intern(mtid, xsink, false))
+         return -1;
+      if (write_pending && waiting)
+         asl_cond.broadcast();
+      return 0;
+   }
+
    tid_map_t::iterator i = tmap.find(mtid);
    if (i == tmap.end()) {
       xsink->raiseException("LOCK-ERROR", "TID %d called %s::readUnlock() while not holding the read lock", mtid, getName());
@@ -402,11 +719,28 @@ int RWLock::readUnlock(ExceptionSink* xsink) {
 }
 
 int RWLock::tryReadLock() {
+   if (stripes) {
+      int mtid = gettid();
+      VLock* nvl = getVLock();
+      if (!qore_lock_profiling)
+         return try_stripe_read_lock_intern(mtid, nvl);
+
+      AutoLocker al(&asl_lock);
+      QoreLockProfileHelper lph(this, nvl);
+      if (try_stripe_read_lock_intern(mtid, nvl))
+         return -1;
+      lph.acquired();
+      return 0;
+   }
+
    AutoLocker al(&asl_lock);
    if (tid != Lock_Unlocked)
       return -1;
 
-   mark_read_lock_intern(gettid(), getVLock());
+   VLock* nvl = getVLock();
+   QoreLockProfileHelper lph(this, nvl);
+   mark_read_lock_intern(gettid(), nvl);
+   lph.acquired();
 
    return 0;
 }
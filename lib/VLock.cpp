@@ -145,88 +145,86 @@ void AutoVLock::addMemberNotification(QoreObject *obj, const char *member) {
    priv->add(obj, member);
 }
 
-int VLock::waitOn(AbstractSmartLock *asl, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
-   waiting_on = asl;
-   
-   int rc = 0;
-   AbstractSmartLock *vl_wait = vl->waiting_on;
-   //printd(5, "VLock::waitOn(asl=%p) vl_wait=%p other_tid=%d\n", asl, vl_wait, vl->tid);
-   if (vl_wait && find(vl_wait)) {
-      // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-      // (even if it really wouldn't technically deadlock at this point due to the timeout)
-      if (timeout_ms)
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", vl->tid, tid, asl->getName());
-      else
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", vl->tid, tid);
-      rc = -1;
-   }
+// serializes deadlock checks so that only one thread in a deadlock raises an exception
+static QoreThreadLock deadlock_lock;
 
-   if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
-   }
-   
-   waiting_on = 0;
-   
-   return rc;
+// must be called with deadlock_lock held
+VLock *VLock::checkDeadlock(VLock *vl) const {
+   if (!vl)
+      return 0;
+
+   AbstractSmartLock *vl_wait = vl->waiting_on;
+   return vl_wait && find(vl_wait) ? vl : 0;
 }
 
-int VLock::waitOn(AbstractSmartLock *asl, QoreCondition *cond, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
+int VLock::waitIntern(AbstractSmartLock *asl, QoreCondition *cond, VLock *vl, vlock_map_t *vmap, ExceptionSink *xsink, int timeout_ms) {
    waiting_on = asl;
+   ++waits;
 
    int rc = 0;
-   AbstractSmartLock *vl_wait = vl->waiting_on;
-   //printd(5, "VLock::waitOn(asl=%p) vl_wait=%p other_tid=%d\n", asl, vl_wait, vl->tid);
-   if (vl_wait && find(vl_wait)) {
-      // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-      // (even if it really wouldn't technically deadlock at this point due to the timeout)
-      if (timeout_ms)
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", vl->tid, tid, asl->getName());
+   if (check_on != asl) {
+      // first wait for a short time without checking for deadlocks; if the timeout is shorter than the check interval,
+      // then the wait cannot deadlock
+      int to = timeout_ms && timeout_ms <= QORE_VLOCK_CHECK_MS ? timeout_ms : QORE_VLOCK_CHECK_MS;
+      rc = cond ? asl->self_wait(cond, to) : asl->self_wait(to);
+      waiting_on = 0;
+      if (!rc || to == timeout_ms)
+         return rc;
+
+      // the lock is still not available: return to the caller, which will check the lock status and call this
+      // function again with the current lock owner(s), at which point deadlocks are checked
+      check_on = asl;
+      return 0;
+   }
+   check_on = 0;
+
+   {
+      AutoLocker al(deadlock_lock);
+      VLock *dvl = 0;
+      if (vmap) {
+         for (vlock_map_t::iterator i = vmap->begin(), e = vmap->end(); i != e; ++i) {
+            dvl = checkDeadlock(i->second);
+            if (dvl)
+               break;
+         }
+      }
       else
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", vl->tid, tid);
-      rc = -1;
+         dvl = checkDeadlock(vl);
+
+      if (dvl) {
+         // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
+         // (even if it really wouldn't technically deadlock at this point due to the timeout)
+         if (timeout_ms)
+            xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", dvl->tid, tid, asl->getName());
+         else
+            xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", dvl->tid, tid);
+         // cleared while deadlock_lock is held so that the other thread does not also detect the deadlock; this
+         // thread will release its locks when the exception is handled
+         waiting_on = 0;
+         rc = -1;
+      }
    }
-   
+
    if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(cond, timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
+      // the short wait has already been made
+      int to = timeout_ms ? timeout_ms - QORE_VLOCK_CHECK_MS : 0;
+      rc = cond ? asl->self_wait(cond, to) : asl->self_wait(to);
+      waiting_on = 0;
    }
 
-   waiting_on = 0;
-   
    return rc;
 }
 
-int VLock::waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, ExceptionSink *xsink, int timeout_ms) {
-   waiting_on = asl;
-
-   int rc = 0;
-   for (vlock_map_t::iterator i = vmap.begin(), e = vmap.end(); i != e; ++i) {
-      AbstractSmartLock *vl_wait = i->second->waiting_on;
-      //printd(5, "VLock::waitOn(asl=%p, vmap size=%d) vl_wait=%p other_tid=%d\n", asl, vmap.size(), vl_wait, i->second->tid);
-      if (vl_wait && find(vl_wait)) {
-	 // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-	 // (even if it really wouldn't technically deadlock at this point due to the timeout)
-	 if (timeout_ms)
-	    xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", i->second->tid, tid, asl->getName());
-	 else
-	    xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", i->second->tid, tid);
-	 rc = -1;
-	 break;
-      }
-   }
-   
-   if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
-   }
+int VLock::waitOn(AbstractSmartLock *asl, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
+   return waitIntern(asl, 0, vl, 0, xsink, timeout_ms);
+}
 
-   waiting_on = 0;
+int VLock::waitOn(AbstractSmartLock *asl, QoreCondition *cond, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
+   return waitIntern(asl, cond, vl, 0, xsink, timeout_ms);
+}
 
-   return rc;
+int VLock::waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, ExceptionSink *xsink, int timeout_ms) {
+   return waitIntern(asl, 0, 0, &vmap, xsink, timeout_ms);
 }
 
 #ifdef DEBUG
@@ -235,40 +233,52 @@ void VLock::show(class VLock *vl) const {
 }
 #endif
 
-VLock::VLock(int n_tid) : waiting_on(0), tid(n_tid) {
+VLock::VLock(int n_tid) : waiting_on(0), check_on(0), tid(n_tid), waits(0), held(fixed), len(0), cap(QORE_VLOCK_FIXED) {
 }
 
 VLock::~VLock() {
    //printd(5, "VLock::~VLock() this=%p\n", this);
-   assert(begin() == end());
+   assert(!len);
+   if (held != fixed)
+      delete [] held;
 }
 
 void VLock::push(AbstractSmartLock *g) {
-   //printd(5, "VLock::push() this=%p asl=%p size=%d\n", this, g, size());
-   push_back(g);
+   //printd(5, "VLock::push() this=%p asl=%p size=%d\n", this, g, len);
+   if (len == cap) {
+      AbstractSmartLock **nh = new AbstractSmartLock*[cap * 2];
+      memcpy(nh, held, sizeof(AbstractSmartLock*) * len);
+      if (held != fixed)
+         delete [] held;
+      held = nh;
+      cap *= 2;
+   }
+   held[len++] = g;
+   // a lock has been acquired, so any pending deadlock check is obsolete
+   check_on = 0;
 }
 
 int VLock::pop(AbstractSmartLock *g) {
-   assert(begin() != end());
+   assert(len);
 
-   if (g == back()) {
-      pop_back();
+   if (g == held[len - 1]) {
+      --len;
       return 0;
    }
 
-   abstract_lock_list_t::iterator i = end();
-   --i;
-   --i;
-   while (*i != g) 
-      --i;
+   // locks are normally released in reverse order, so search from the end
+   unsigned i = len - 1;
+   while (held[--i] != g)
+      assert(i);
 
-   erase(i);
+   memmove(held + i, held + i + 1, sizeof(AbstractSmartLock*) * (len - i - 1));
+   --len;
    return -1;
 }
 
 AbstractSmartLock *VLock::find(class AbstractSmartLock *g) const {
-   for (abstract_lock_list_t::const_iterator i = begin(), e = end(); i != e; ++i)
-      if (*i == g)
+   for (unsigned i = len; i; --i)
+      if (held[i - 1] == g)
 	 return g;
    return 0;
 }
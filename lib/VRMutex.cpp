@@ -40,9 +40,12 @@ int VRMutex::enter(ExceptionSink *xsink) {
    int mtid = gettid();
    VLock *nvl = getVLock();
    AutoLocker al(&asl_lock);
+   QoreLockProfileHelper lph(this, nvl);
    int rc = VRMutex::grabImpl(mtid, nvl, xsink);
-   if (!rc)
+   if (!rc) {
       mark_and_push(mtid, nvl);
+      lph.acquired();
+   }
    return rc;
 }
 
@@ -102,7 +102,7 @@ QoreValue VarRefNode::evalValueImpl(bool& needs_deref, ExceptionSink* xsink) con
    else {
       assert(needs_deref);
       printd(5, "VarRefNode::evalImpl() this: %p global var: %p (%s)\n", this, ref.var, ref.var->getName());
-      v = ref.var->eval();
+      v = qore_program_private::runtimeGetGlobalVar(ref.var)->eval();
    }
 
    AbstractQoreNode* n = v.getInternalNode();
@@ -194,7 +194,7 @@ int VarRefNode::getLValue(LValueHelper& lvh, bool for_remove) const {
    if (type == VT_IMMEDIATE)
       return ref.cvv->getLValue(lvh, for_remove);
    assert(type == VT_GLOBAL);
-   return ref.var->getLValue(lvh, for_remove);
+   return qore_program_private::runtimeGetGlobalVar(ref.var)->getLValue(lvh, for_remove);
 }
 
 DLLLOCAL void VarRefNode::remove(LValueRemoveHelper& lvrh) {
@@ -207,7 +207,7 @@ DLLLOCAL void VarRefNode::remove(LValueRemoveHelper& lvrh) {
    if (type == VT_IMMEDIATE)
       return ref.cvv->remove(lvrh);
    assert(type == VT_GLOBAL);
-   return ref.var->remove(lvrh);
+   return qore_program_private::runtimeGetGlobalVar(ref.var)->remove(lvrh);
 }
 
 GlobalVarRefNode::GlobalVarRefNode(char *n, const QoreTypeInfo* typeInfo) : VarRefNode(n, 0, false, true) {
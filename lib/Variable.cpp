@@ -57,6 +57,37 @@ int qore_gvar_ref_u::write(ExceptionSink* xsink) const {
    return 0;
 }
 
+Var::Var(const Var& old, bool) : loc(old.loc), val(old.val.type == QV_Ref ? QV_Ref : QV_Node), name(old.name), parseTypeInfo(0), typeInfo(old.typeInfo), pub(old.pub), finalized(false), clone_slot(-1) {
+   assert(!old.parseTypeInfo);
+
+   if (old.val.type == QV_Ref) {
+      Var* ref = old.val.v.getPtr();
+      ref->ROreference();
+      val.v.setPtr(ref, old.val.v.isReadOnly());
+      return;
+   }
+
+   // try to set an optimized value type for the value holder if possible
+   val.set(typeInfo);
+
+   QoreValue v;
+   {
+      QoreAutoVarRWReadLocker al(old.rwl);
+      if (!old.val.assigned)
+         return;
+      v = old.val.getReferencedValue();
+   }
+
+   switch (v.type) {
+      case QV_Bool: val.assignInitial(v.v.b); break;
+      case QV_Int: val.assignInitial(v.v.i); break;
+      case QV_Float: val.assignInitial(v.v.f); break;
+      case QV_Node: val.assignInitial(v.v.n); break;
+      default: assert(false);
+         // no break
+   }
+}
+
 int Var::getLValue(LValueHelper& lvh, bool for_remove) const {
    if (val.type == QV_Ref) {
       if (val.v.write(lvh.vl.xsink))
@@ -106,6 +137,20 @@ const char* Var::getName() const {
 QoreValue Var::eval() const {
    if (val.type == QV_Ref)
       return val.v.getPtr()->eval();
+
+#ifdef QORE_VAR_RWLOCK_SEQ
+   // int, float, and bool values of variables with a fixed type are stored directly in the value holder and need no
+   // reference, so they can be read without the lock; the read is only repeated with the lock if a write was in progress
+   if (val.fixed_type) {
+      unsigned s = rwl.readSeqBegin();
+      if (!(s & 1)) {
+         QoreValue rv = val.getReferencedValue();
+         if (!rwl.readSeqRetry(s))
+            return rv;
+      }
+   }
+#endif
+
    QoreAutoVarRWReadLocker al(rwl);
    return val.getReferencedValue();
 }
@@ -146,6 +146,7 @@
 #include "QoreReferenceCounter.cpp"
 #include "QoreHTTPClient.cpp"
 #include "QoreHttpClientObject.cpp"
+#include "QoreHttpConnectionPool.cpp"
 #include "ParseOptionMap.cpp"
 #include "SystemEnvironment.cpp"
 #include "QoreCounter.cpp"
@@ -216,6 +217,10 @@
 #include "qc_errno.cpp"
 #include "qc_qore.cpp"
 #include "QC_Socket.cpp"
+#include "QC_SocketPoller.cpp"
+#include "QC_CompressionEncoder.cpp"
+#include "QC_CompressionDecoder.cpp"
+#include "QC_HTTPConnectionPool.cpp"
 #include "QC_Program.cpp"
 #include "QC_ReadOnlyFile.cpp"
 #include "QC_File.cpp"
@@ -249,11 +254,13 @@
 #include "QC_SingleValueIterator.cpp"
 #include "QC_RangeIterator.cpp"
 #include "QC_ThreadPool.cpp"
+#include "QC_Future.cpp"
 #include "QC_AbstractDatasource.cpp"
 #include "QC_Datasource.cpp"
 #include "QC_DatasourcePool.cpp"
 #include "QC_SQLStatement.cpp"
 #include "QC_Queue.cpp"
+#include "QC_QueueSet.cpp"
 #include "QC_Mutex.cpp"
 #include "QC_Condition.cpp"
 #include "QC_RWLock.cpp"
@@ -95,9 +95,28 @@ size_t qore_thread_stack_limit = 0;
 // default thread creation attribute
 QorePThreadAttr ta_default;
 
+// stack size for new threads; 0 = the default stack size
+static size_t qore_new_thread_stack_size = 0;
+static QoreThreadLock lck_stack_size;
+
+#ifdef QORE_MANAGE_STACK
+// returns the stack limit for a thread with the given stack size; used for the default stack size and for sizes set
+// with set_thread_stack_size()
+static size_t q_get_stack_limit(size_t ssize) {
+#ifdef IA64_64
+   // the top half of the stack is for the normal stack, the bottom half is for the register stack, so only half of
+   // the stack is available for each one
+   ssize /= 2;
+#endif // #ifdef IA64_64
+   return ssize - QORE_STACK_GUARD;
+}
+#endif // #ifdef QORE_MANAGE_STACK
+
 DLLLOCAL QoreThreadList thread_list;
 
 DLLLOCAL QoreClass* initThreadPoolClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initFutureClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initQueueSetClass(QoreNamespace& ns);
 
 const qore_class_private* ClassObj::getClass() const {
    if (!ptr)
@@ -304,7 +323,9 @@ public:
    ArgvRefStack argv_refs;
 
 #ifdef QORE_MANAGE_STACK
-   size_t stack_limit;
+   size_t stack_limit,
+      // the maximum stack usage for this thread in bytes
+      stack_max;
 #ifdef IA64_64
    size_t rse_limit;
 #endif
@@ -347,6 +368,11 @@ public:
    // AbstractQoreModule* with boolean ptr in bit 0
    uintptr_t qmi;
 
+#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
+   // the call stack for this thread; owned by the ThreadEntry so that it can be safely read by other threads
+   CallStack* callStack;
+#endif
+
    bool
    foreign : 1; // true if the thread is a foreign thread
 
@@ -357,23 +383,33 @@ public:
       current_pgm(p), current_ns(0), current_implicit_arg(0), tlpd(0), tpd(new ThreadProgramData(this)),
       closure_parse_env(0), closure_rt_env(0),
       returnTypeInfo(0), parse_return_type_info(0), element(0), global_vnode(0), pcs(0),
-      qmc(0), qmd(0), user_module_context_name(0), qmi(0), foreign(n_foreign) {
+      qmc(0), qmd(0), user_module_context_name(0), qmi(0),
+#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
+      callStack(0),
+#endif
+      foreign(n_foreign) {
 
 #ifdef QORE_MANAGE_STACK
+      setStackLimit(qore_thread_stack_limit);
+#endif // #ifdef QORE_MANAGE_STACK
+   }
 
+#ifdef QORE_MANAGE_STACK
+   // sets the stack limit relative to the current stack position
+   DLLLOCAL void setStackLimit(size_t limit) {
+      stack_max = limit;
 #ifdef STACK_DIRECTION_DOWN
-      stack_limit = get_stack_pos() - qore_thread_stack_limit;
+      stack_limit = get_stack_pos() - limit;
 #else
-      stack_limit = get_stack_pos() + qore_thread_stack_limit;
+      stack_limit = get_stack_pos() + limit;
 #endif // #ifdef STACK_DIRECTION_DOWN
 
 #ifdef IA64_64
       // RSE stack grows up
-      rse_limit = get_rse_bsp() + qore_thread_stack_limit;
+      rse_limit = get_rse_bsp() + limit;
 #endif // #ifdef IA64_64
-
-#endif // #ifdef QORE_MANAGE_STACK
    }
+#endif // #ifdef QORE_MANAGE_STACK
 
    DLLLOCAL ~ThreadData() {
       assert(on_block_exit_list.empty());
@@ -455,6 +491,9 @@ void ThreadEntry::activate(int tid, pthread_t n_ptid, QoreProgram* p, bool forei
 #endif
    assert(!thread_data);
    thread_data = new ThreadData(tid, p, foreign);
+#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
+   thread_data->callStack = callStack;
+#endif
    ::thread_data.set(thread_data);
    status = QTS_ACTIVE;
    // set lvstack if QoreProgram set
@@ -591,11 +630,13 @@ public:
    QoreProgram* pgm;
    int tid;
    QoreProgramLocation loc;
+   // the stack size of the new thread (0 = the default stack size)
+   size_t stack_size;
    bool registered, started;
 
    DLLLOCAL BGThreadParams(AbstractQoreNode* f, int t, ExceptionSink* xsink)
       : callobj((thread_data.get())->current_classobj), obj(0),
-        fc(f), pgm(getProgram()), tid(t), loc(RunTimeLocation), registered(false), started(false) {
+        fc(f), pgm(getProgram()), tid(t), loc(RunTimeLocation), stack_size(0), registered(false), started(false) {
       //printd(5, "BGThreadParams::BGThreadParams(f: %p (%s %d), t: %d) this: %p callobj: %p\n", f, f->getTypeName(), f->getType(), t, this, callobj);
 
       // first try to preregister the new thread
@@ -751,7 +792,7 @@ int check_stack(ExceptionSink* xsink) {
 #ifdef IA64_64
    //printd(5, "check_stack() bsp current: %p limit: %p\n", get_rse_bsp(), td->rse_limit);
    if (td->rse_limit < get_rse_bsp()) {
-      xsink->raiseException("STACK-LIMIT-EXCEEDED", "this thread's stack has exceeded the IA-64 RSE (Register Stack Engine) stack size limit (%ld bytes)", qore_thread_stack_limit);
+      xsink->raiseException("STACK-LIMIT-EXCEEDED", "this thread's stack has exceeded the IA-64 RSE (Register Stack Engine) stack size limit (%ld bytes)", td->stack_max);
       return -1;
    }
 
@@ -764,7 +805,7 @@ int check_stack(ExceptionSink* xsink) {
    <
 #endif
    get_stack_pos()) {
-      xsink->raiseException("STACK-LIMIT-EXCEEDED", "this thread's stack has exceeded the stack size limit (%ld bytes)", qore_thread_stack_limit);
+      xsink->raiseException("STACK-LIMIT-EXCEEDED", "this thread's stack has exceeded the stack size limit (%ld bytes)", td->stack_max);
       return -1;
    }
 
@@ -1402,19 +1443,19 @@ const QoreListNode* thread_get_implicit_args() {
 
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
 void pushCall(CallNode* cn) {
-   thread_list.pushCall(cn);
+   thread_data.get()->callStack->push(cn);
 }
 
 void popCall(ExceptionSink* xsink) {
-   thread_list.popCall(xsink);
+   thread_data.get()->callStack->pop(xsink);
 }
 
 QoreListNode* getCallStackList() {
-   return thread_list.getCallStackList();
+   return thread_data.get()->callStack->getCallStack();
 }
 
 CallStack* getCallStack() {
-   return thread_list.getCallStack();
+   return thread_data.get()->callStack;
 }
 #endif
 
@@ -1457,7 +1498,8 @@ ProgramThreadCountContextHelper::ProgramThreadCountContextHelper(ExceptionSink*
 
    ThreadData* td = thread_data.get();
    printd(5, "ProgramThreadCountContextHelper::ProgramThreadCountContextHelper() current_pgm: %p new_pgm: %p\n", td->current_pgm, pgm);
-   if (pgm != td->current_pgm) {
+   // code from the source of a program clone is executed in the context of the clone
+   if (pgm != td->current_pgm && pgm != qore_program_private::getCloneSource(td->current_pgm)) {
       // try to increment thread count
       if (qore_program_private::incThreadCount(*pgm, xsink))
          return;
@@ -1762,7 +1804,7 @@ int q_reserve_foreign_thread_id() {
 }
 
 int q_release_reserved_foreign_thread_id(int tid) {
-   if (tid < 0 || tid >= MAX_QORE_THREADS)
+   if (!thread_list.valid(tid))
       return -1;
 
    // release the thread entry
@@ -1770,7 +1812,7 @@ int q_release_reserved_foreign_thread_id(int tid) {
 }
 
 int q_register_reserved_foreign_thread(int tid) {
-   if (tid < 0 || tid >= MAX_QORE_THREADS)
+   if (!thread_list.valid(tid))
       return -1;
 
    return thread_list.activateReserved(tid);
@@ -1828,8 +1870,10 @@ struct ThreadArg {
    q_thread_t f;
    void* arg;
    int tid;
+   // the stack size of the new thread (0 = the default stack size)
+   size_t stack_size;
 
-   DLLLOCAL ThreadArg(q_thread_t n_f, void* a, int n_tid) : f(n_f), arg(a), tid(n_tid) {
+   DLLLOCAL ThreadArg(q_thread_t n_f, void* a, int n_tid) : f(n_f), arg(a), tid(n_tid), stack_size(0) {
    }
 
    DLLLOCAL void run(ExceptionSink* xsink) {
@@ -1843,6 +1887,10 @@ namespace {
       ThreadArg* ta = (ThreadArg*)arg;
 
       register_thread(ta->tid, pthread_self(), 0);
+#ifdef QORE_MANAGE_STACK
+      if (ta->stack_size)
+         thread_data.get()->setStackLimit(q_get_stack_limit(ta->stack_size));
+#endif
       printd(5, "q_run_thread() ta: %p TID %d started\n", ta, ta->tid);
 
       pthread_cleanup_push(qore_thread_cleanup, (void*)0);
@@ -1884,6 +1932,10 @@ namespace {
       BGThreadParams* btp = (BGThreadParams*) x;
       // register thread
       register_thread(btp->tid, pthread_self(), btp->pgm);
+#ifdef QORE_MANAGE_STACK
+      if (btp->stack_size)
+         thread_data.get()->setStackLimit(q_get_stack_limit(btp->stack_size));
+#endif
       printd(5, "op_background_thread() btp: %p TID %d started\n", btp, btp->tid);
       //printf("op_background_thread() btp: %p TID %d started\n", btp, btp->tid);
 
@@ -1948,6 +2000,53 @@ namespace {
    }
 }
 
+// returns the stack size for new threads or 0 for the default stack size
+static size_t q_get_new_thread_stack_size() {
+   AutoLocker al(lck_stack_size);
+   return qore_new_thread_stack_size;
+}
+
+// creates a thread with the given stack size (0 = the default stack size)
+static int q_pthread_create(pthread_t* ptid, size_t ssize, void* (*f)(void*), void* arg) {
+   if (!ssize)
+      return pthread_create(ptid, ta_default.get_ptr(), f, arg);
+
+   QorePThreadAttr ta;
+   int rc = ta.setstacksize(ssize);
+   return rc ? rc : pthread_create(ptid, ta.get_ptr(), f, arg);
+}
+
+size_t q_get_thread_stack_size() {
+   size_t ssize = q_get_new_thread_stack_size();
+   if (ssize)
+      return ssize;
+#ifdef QORE_MANAGE_STACK
+   return qore_thread_stack_size;
+#else
+   return ta_default.getstacksize();
+#endif
+}
+
+int q_set_thread_stack_size(size_t ssize, ExceptionSink* xsink) {
+   if (ssize) {
+      if (ssize < QORE_THREAD_STACK_MIN) {
+         xsink->raiseException("THREAD-STACK-ERROR", "cannot set the thread stack size to %lu bytes; the minimum stack size is %d bytes", (unsigned long)ssize, QORE_THREAD_STACK_MIN);
+         return -1;
+      }
+      // make sure that the stack size is accepted before it's used for new threads
+      QorePThreadAttr ta;
+      int rc = ta.setstacksize(ssize);
+      if (rc) {
+         xsink->raiseErrnoException("THREAD-STACK-ERROR", rc, "cannot set the thread stack size to %lu bytes", (unsigned long)ssize);
+         return -1;
+      }
+   }
+
+   AutoLocker al(lck_stack_size);
+   qore_new_thread_stack_size = ssize;
+   return 0;
+}
+
 static AbstractQoreNode* op_background(const AbstractQoreNode* left, const AbstractQoreNode* ignored, bool ref_rv, ExceptionSink* xsink) {
    if (!left)
       return 0;
@@ -1967,7 +2066,7 @@ static AbstractQoreNode* op_background(const AbstractQoreNode* left, const Abstr
 
    // if can't start thread, then throw exception
    if (tid == -1) {
-      xsink->raiseException("THREAD-CREATION-FAILURE", "thread list is full with %d threads", MAX_QORE_THREADS);
+      xsink->raiseException("THREAD-CREATION-FAILURE", "thread list is full with %d threads", QORE_THREAD_TID_LIMIT);
       return 0;
    }
 
@@ -1985,7 +2084,8 @@ static AbstractQoreNode* op_background(const AbstractQoreNode* left, const Abstr
    //printd(5, "calling pthread_create(%p, %p, %p, %p)\n", &ptid, &ta_default, op_background_thread, tp);
    thread_counter.inc();
 
-   if ((rc = pthread_create(&ptid, ta_default.get_ptr(), op_background_thread, tp))) {
+   tp->stack_size = q_get_new_thread_stack_size();
+   if ((rc = q_pthread_create(&ptid, tp->stack_size, op_background_thread, tp))) {
       tp->cleanup(xsink);
       tp->del(xsink);
 
@@ -2004,7 +2104,7 @@ int q_start_thread(ExceptionSink* xsink, q_thread_t f, void* arg) {
 
    // if can't start thread, then throw exception
    if (tid == -1) {
-      xsink->raiseException("THREAD-CREATION-FAILURE", "thread list is full with %d threads", MAX_QORE_THREADS);
+      xsink->raiseException("THREAD-CREATION-FAILURE", "thread list is full with %d threads", QORE_THREAD_TID_LIMIT);
       return -1;
    }
 
@@ -2017,7 +2117,8 @@ int q_start_thread(ExceptionSink* xsink, q_thread_t f, void* arg) {
 
    //printd(5, "calling pthread_create(%p, %p, %p, %p)\n", &ptid, &ta_default, op_background_thread, tp);
    thread_counter.inc();
-   if ((rc = pthread_create(&ptid, ta_default.get_ptr(), q_run_thread, ta))) {
+   ta->stack_size = q_get_new_thread_stack_size();
+   if ((rc = q_pthread_create(&ptid, ta->stack_size, q_run_thread, ta))) {
       delete ta;
       thread_counter.dec();
       deregister_thread(tid);
@@ -2037,25 +2138,11 @@ static AbstractQoreNode* check_op_background(QoreTreeNode* tree, LocalVar* oflag
    return tree->defaultParseInit(oflag, pflag, lvids, returnTypeInfo);
 }
 
-#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
-#include <qore/QoreRWLock.h>
-
-#ifdef _Q_WINDOWS
-extern QoreRWLock* thread_stack_lock;
-#else
-extern QoreRWLock thread_stack_lock;
-#endif
-#endif
-
 static int initial_thread;
 
 void init_qore_threads() {
    QORE_TRACE("qore_init_threads()");
 
-#if defined(QORE_RUNTIME_THREAD_STACK_TRACE) && defined(_Q_WINDOWS)
-   thread_stack_lock = new QoreRWLock;
-#endif
-
 #ifdef QORE_MANAGE_STACK
    // get default stack size
 #ifdef SOLARIS
@@ -2078,11 +2165,9 @@ void init_qore_threads() {
 #endif // #ifdef _Q_WINDOWS
 #endif // #ifdef SOLARIS
 
-#ifdef IA64_64
-   // the top half of the stack is for the normal stack, the bottom half is for the register stack
-   qore_thread_stack_size /= 2;
-#endif // #ifdef IA64_64
-   qore_thread_stack_limit = qore_thread_stack_size - QORE_STACK_GUARD;
+   // qore_thread_stack_size is the real stack size as returned by get_thread_stack_size(); on IA-64 the stack limit is
+   // halved for the register stack in q_get_stack_limit()
+   qore_thread_stack_limit = q_get_stack_limit(qore_thread_stack_size);
    //printd(8, "default stack size %ld, limit %ld\n", qore_thread_stack_size, qore_thread_stack_limit);
 #endif // #ifdef QORE_MANAGE_STACK
 
@@ -2106,6 +2191,7 @@ QoreNamespace* get_thread_ns(QoreNamespace &qorens) {
    QoreNamespace* Thread = new QoreNamespace("Thread");
 
    Thread->addSystemClass(initQueueClass(*Thread));
+   Thread->addSystemClass(initQueueSetClass(*Thread));
    Thread->addSystemClass(initAbstractSmartLockClass(*Thread));
    Thread->addSystemClass(initMutexClass(*Thread));
    Thread->addSystemClass(initConditionClass(*Thread));
@@ -2119,6 +2205,8 @@ QoreNamespace* get_thread_ns(QoreNamespace &qorens) {
    Thread->addSystemClass(initAutoReadLockClass(*Thread));
    Thread->addSystemClass(initAutoWriteLockClass(*Thread));
 
+   // the Future class must be initialized before ThreadPool, which returns Future objects
+   Thread->addSystemClass(initFutureClass(*Thread));
    Thread->addSystemClass(initThreadPoolClass(*Thread));
 
    return Thread;
@@ -2149,12 +2237,6 @@ void delete_qore_threads() {
    assert(initial_thread);
    thread_list.deleteDataRelease(initial_thread);
 
-#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
-#ifdef _Q_WINDOWS
-   delete thread_stack_lock;
-#endif
-#endif
-
 #ifdef HAVE_MPFR_BUILDOPT_TLS_T
    // only call mpfr_free_cache if MPFR uses TLS
    if (mpfr_buildopt_tls_p())
@@ -2174,14 +2256,6 @@ QoreListNode* get_thread_list() {
 }
 
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
-#include <qore/QoreRWLock.h>
-
-#ifdef _Q_WINDOWS
-extern QoreRWLock* thread_stack_lock;
-#else
-extern QoreRWLock thread_stack_lock;
-#endif
-
 QoreHashNode* getAllCallStacks() {
    return thread_list.getAllCallStacks();
 }
@@ -2190,17 +2264,16 @@ QoreHashNode* QoreThreadList::getAllCallStacks() {
    QoreHashNode* h = new QoreHashNode;
    QoreString str;
 
-   // grab the call stack write lock
-   QoreAutoRWWriteLocker wl(thread_stack_lock);
-
+   // the thread list lock held by the iterator ensures that call stacks are not deleted while they are read;
+   // each call stack is then read under its own lock, so only the thread being read is blocked
    QoreThreadListIterator i;
    if (exiting)
       return h;
 
    while (i.next()) {
       // get call stack
-      if (entry[*i].callStack) {
-         QoreListNode* l = entry[*i].callStack->getCallStack();
+      if (entry(*i).callStack) {
+         QoreListNode* l = entry(*i).callStack->getCallStack();
          if (!l->empty()) {
             // make hash entry
             str.clear();
@@ -2246,7 +2319,7 @@ void QoreThreadList::deleteData(int tid) {
 
 #ifdef DEBUG
    AutoLocker al(l);
-   entry[tid].thread_data = 0;
+   entry(tid).thread_data = 0;
 #endif
 }
 
@@ -2256,7 +2329,7 @@ void QoreThreadList::deleteDataRelease(int tid) {
 
    AutoLocker al(l);
 #ifdef DEBUG
-   entry[tid].thread_data = 0;
+   entry(tid).thread_data = 0;
 #endif
 
    releaseIntern(tid);
@@ -2280,30 +2353,16 @@ unsigned QoreThreadList::cancelAllActiveThreads() {
 
    while (i.next()) {
       if (*i != (unsigned)tid) {
-         //printf("QoreThreadList::cancelAllActiveThreads() canceling TID %d ptid: %p (this TID: %d)\n", *i, entry[*i].ptid, tid);
-         int trc = pthread_cancel(entry[*i].ptid);
+         //printf("QoreThreadList::cancelAllActiveThreads() canceling TID %d ptid: %p (this TID: %d)\n", *i, entry(*i).ptid, tid);
+         int trc = pthread_cancel(entry(*i).ptid);
          if (!trc)
             ++tcc;
 #ifdef DEBUG
          else
-            printd(0, "pthread_cancel() returned %d (%s) on tid %d (%p)\n", trc, strerror(trc), tid, entry[*i].ptid);
+            printd(0, "pthread_cancel() returned %d (%s) on tid %d (%p)\n", trc, strerror(trc), tid, entry(*i).ptid);
 #endif
       }
    }
 
    return tcc;
 }
-
-#ifdef QORE_RUNTIME_THREAD_STACK_TRACE
-void QoreThreadList::pushCall(CallNode* cn) {
-   entry[gettid()].callStack->push(cn);
-}
-
-void QoreThreadList::popCall(ExceptionSink* xsink) {
-   entry[gettid()].callStack->pop(xsink);
-}
-
-QoreListNode* QoreThreadList::getCallStackList() {
-   return entry[gettid()].callStack->getCallStack();
-}
-#endif